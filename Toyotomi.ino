@@ -12,11 +12,43 @@
 #include <XbeeRadio.h>
 #include <XBee.h>
 #include <Toyotomi.h>
+#include <ToyotomiCommands.h>
 
 #include <Uberdust.h>
 
 //#define ZONE_NAME "light"
 
+// Uncomment to report the state as seven uberdust text values instead of
+// one binary packet
+//#define STRING_STATE_REPORT
+
+// first payload byte of the binary state report (uberdust text uses 102)
+#define STATE_REPORT 103
+
+// first payload byte of the task run time report
+#define TASK_REPORT 104
+
+// first payload byte of a command statistics report
+#define STATS_REPORT 105
+
+// first payload byte of the frame trace dump
+#define TRACE_REPORT 106
+
+#define STAT_COMMANDS    14       // commands 1 - 14 are measured
+#define STAT_UNIT_CYCLES (F_CPU / 10000L)   // 100 us
+
+#define HEARTBEAT_PERIOD 5000     // ms
+#define LED_FLASH        100      // ms
+#define BEACON_PERIOD    60000    // ms
+
+// ms from the first of a burst of set-commands (1 - 5) to the one frame
+// sent for all of them, 0 sends a frame for every command
+#define COALESCE_WINDOW  300
+
+// Comment out to poll the radio continuously instead of sleeping in IDLE
+// until the next interrupt (received character, millis() tick, IR edge)
+#define IDLE_SLEEP
+
 // Create the xbee object
 XBeeRadio xbee = XBeeRadio(); 
 
@@ -32,13 +64,119 @@ Tx16Request tx = Tx16Request(0xffff, payload, sizeof(payload));
 
 TxStatusResponse txStatus = TxStatusResponse();
 
+// STATE_REPORT, the CHANGED_* mask (low byte first) and the PackedState,
+// sent as a single packet
+uint8_t statePayload[3 + sizeof(PackedState)] = { STATE_REPORT };
+Tx16Request stateTx = Tx16Request(0xffff, statePayload, sizeof(statePayload));
+
 
 uint8_t ledPin = 13;
+bool ledOn = false;
 
 
 Uberdust uber = Uberdust();
 Toyotomi toyo = Toyotomi(DEFAULT_TEMP, AUTO, DEFAULT_SP, DEFAULT_TIMER, DEFAULT_TIMER, DEFAULT_POWER);
 
+// what ToyotomiCommands needs from the sketch: the XBee, the coalesce task
+// and the command statistics
+struct SketchHost
+{
+  void scheduleCommit(uint16_t ms);
+  void commandStarting(uint8_t command);
+  void commandDone(bool windowed) {}
+  void windowClosing(void);
+  void windowClosed(void) {}
+  void sendStats(uint8_t command);
+  void sendTrace(void);
+  void sendPackedState(uint16_t changes, const PackedState &state);
+  void sendValue(const char *name, int value);
+};
+
+SketchHost host;
+#ifdef STRING_STATE_REPORT
+ToyotomiCommands<SketchHost> commands(toyo, host, COALESCE_WINDOW, true);
+#else
+ToyotomiCommands<SketchHost> commands(toyo, host, COALESCE_WINDOW);
+#endif
+
+// the command being handled, 1 and the command first
+uint8_t packet[COMMAND_LEN];
+uint32_t packetReceived;
+
+/*
+ * Cooperative scheduler. Every task runs to completion, returns the ms
+ * until it is due again (0 for every pass of loop()) and must not block,
+ * so a command waits at most for the longest task. The longest run of
+ * each task is kept and reported with the capabilities.
+ */
+struct Task
+{
+  unsigned long (*run)(void);
+  unsigned long due;          // millis()
+  unsigned long worstUs;
+};
+
+// returned by a task that only runs when another one sets its due time
+#define TASK_SLEEP 0x7FFFFFFFUL
+
+unsigned long radioTask(void);
+unsigned long irTask(void);
+unsigned long heartbeatTask(void);
+unsigned long beaconTask(void);
+unsigned long coalesceTask(void);
+
+enum { RADIO_TASK, IR_TASK, HEARTBEAT_TASK, BEACON_TASK, COALESCE_TASK, TASKS };
+
+Task tasks[TASKS] = {
+  { radioTask,     0,             0 },
+  { irTask,        0,             0 },
+  { heartbeatTask, 0,             0 },
+  { beaconTask,    BEACON_PERIOD, 0 },
+  { coalesceTask,  0,             0 }
+};
+
+// TASK_REPORT, the worst run time of every task, the awake permille and the skipped frames
+uint8_t taskPayload[1 + 4 * TASKS + 2 + 2] = { TASK_REPORT };
+Tx16Request taskTx = Tx16Request(0xffff, taskPayload, sizeof(taskPayload));
+
+// min, max and sum of a measurement; min and max saturate at 65535, a
+// min above max means no samples yet
+struct Stat
+{
+  uint16_t min;
+  uint16_t max;
+  uint32_t sum;
+};
+
+/*
+ * Cost of one command type. The frame a command causes is measured once it
+ * is out; commands coalesced into an open window only count.
+ */
+struct CommandStats
+{
+  uint16_t count;
+  Stat latency;         // packet received to IR start, 100 us
+  Stat transmit;        // IR start until the transmitter is idle, 100 us
+  Stat encode;          // CPU cycles from the dispatch (or window commit) to IR start
+  Stat report;          // sending the state report, 100 us
+};
+
+CommandStats stats[STAT_COMMANDS];
+
+// the command waiting for its frame, 0 if none
+uint8_t pendingCommand = 0;
+uint32_t pendingReceived;
+uint32_t pendingEncode;
+uint16_t pendingFrames;
+
+// TRACE_REPORT and the traced frames, oldest first
+uint8_t tracePayload[1 + IR_TRACE_LEN * IR_TRACE_ENTRY_BYTES] = { TRACE_REPORT };
+Tx16Request traceTx = Tx16Request(0xffff, tracePayload, sizeof(tracePayload));
+
+// STATS_REPORT, the command and its CommandStats
+uint8_t statsPayload[2 + sizeof(CommandStats)] = { STATS_REPORT };
+Tx16Request statsTx = Tx16Request(0xffff, statsPayload, sizeof(statsPayload));
+
 void setup()
 {
 
@@ -48,6 +186,9 @@ void setup()
   xbee.init();
 
   uber.setup(&xbee, &tx);
+  pinMode(ledPin, OUTPUT);
+  for (uint8_t i = 0; i < STAT_COMMANDS; i++)
+    stats[i].latency.min = stats[i].transmit.min = stats[i].encode.min = stats[i].report.min = 0xFFFF;
 /*
   delay(1000);
   uber.blinkLED(numOfRelays, 200*numOfRelays);
@@ -58,112 +199,215 @@ void setup()
 
 void loop()
 {
-  static unsigned long ledTimestamp = 0;
+  runTasks();
+#ifdef IDLE_SLEEP
+  Toyotomi::idle();
+#endif
+}
+
+// runs every due task once, earliest deadline first
+void runTasks(void)
+{
+  unsigned long now = millis();
+  uint8_t ran = 0;
+  int8_t next;
 
-  if(millis() - ledTimestamp > 5000)
+  for (;;)
   {
-    uber.blinkLED(1,100);
-    ledTimestamp = millis();
+    next = -1;
+    for (uint8_t i = 0; i < TASKS; i++)
+      if (!(ran & _BV(i)) && (long)(now - tasks[i].due) >= 0 &&
+          (next < 0 || (long)(tasks[i].due - tasks[next].due) < 0))
+        next = i;
+    if (next < 0)
+      return;
+
+    ran |= _BV(next);
+    runTask(tasks[next]);
   }
+}
+
+void runTask(Task &task)
+{
+  unsigned long start = micros();
+  unsigned long wait = task.run();
+  unsigned long took = micros() - start;
+
+  if (took > task.worstUs)
+    task.worstUs = took;
+  task.due = millis() + wait;
+}
+
+unsigned long radioTask(void)
+{
+  uint32_t received;
 
   if (xbee.checkForData(112))
   {
+    received = halCycles();
     xbee.getResponse(response);
     if (response.getData(0) == 1)
-    {
-      switch(response.getData(1))
-      {
-         case 1: //temperature
-             toyo.setTemperature(response.getData(2));
-             sendState(toyo);
-             break;
-         case 2: //mode
-             toyo.setMode((Mode)response.getData(2));
-             sendState(toyo);
-             break;
-         case 3: //fanspeed
-             toyo.setFanSpeed((FanSpeed)response.getData(2));
-             sendState(toyo);
-             break;             
-         case 4: //timeron
-             toyo.setTimerOn((TimerTime)response.getData(2));
-             sendState(toyo);
-             break;
-         case 5: //timeroff
-             toyo.setTimerOff((TimerTime)response.getData(2));
-             sendState(toyo);
-             break;
-         case 6: //poweron
-             toyo.powerOn();
-             sendState(toyo);
-             break;
-         case 7: //poweroff
-             toyo.powerOff();
-             sendState(toyo);
-             break;
-         case 8: //swing
-             toyo.buttonSwing();
-             sendState(toyo);
-             break;
-         /*case 9: //sleep
-             toyo.setSleep((bool)response.getData(2));
-             sendState(toyo);
-             break;*/
-         case 10: //airdirection
-             toyo.buttonAirDirection();
-             sendState(toyo);
-             break;
-         case 11: //cleanair
-             toyo.buttonCleanAir();
-             sendState(toyo);
-             break;
-         case 12: //leddisplay
-             toyo.buttonLedDisplay();
-             sendState(toyo);
-             break;
-         case 13: //turbo
-             toyo.buttonTurbo();
-             sendState(toyo);
-             break;
-         case 14: //setvalues
-             toyo.setState(response.getData(2), (Mode)response.getData(3), (FanSpeed)response.getData(4));
-             sendState(toyo);
-             break;
-         default:
-             break;
-      }
-    }
+      handleCommand(received);
+  }
+
+  return 0;
+}
+
+// reports the state once the unit has been sent the frames for it
+unsigned long irTask(void)
+{
+  CommandStats *command;
+  uint32_t start;
+
+  if (commands.isCoalescing() || toyo.isTransmitting())
+    return 0;
+  if (!pendingCommand)
+  {
+    commands.sendState();
+    return 0;
+  }
+
+  command = &stats[pendingCommand - 1];
+  if (toyo.getFramesSent() != pendingFrames)
+  {
+    start = toyo.getLastFrameStart();
+    addStat(command->latency, (start - pendingReceived) / STAT_UNIT_CYCLES);
+    addStat(command->transmit, toyo.getLastFrameCycles() / STAT_UNIT_CYCLES);
+    addStat(command->encode, start - pendingEncode);
   }
-    
-  periodicCapabilities();
+  pendingCommand = 0;
+
+  start = halCycles();
+  commands.sendState();
+  addStat(command->report, (halCycles() - start) / STAT_UNIT_CYCLES);
+
+  return 0;
+}
+
+void addStat(Stat &stat, uint32_t value)
+{
+  uint16_t clipped = value > 0xFFFF ? 0xFFFF : value;
+
+  if (clipped < stat.min)
+    stat.min = clipped;
+  if (clipped > stat.max)
+    stat.max = clipped;
+  stat.sum += value;
+}
+
+unsigned long heartbeatTask(void)
+{
+  ledOn = !ledOn;
+  digitalWrite(ledPin, ledOn ? HIGH : LOW);
+
+  return ledOn ? LED_FLASH : HEARTBEAT_PERIOD - LED_FLASH;
+}
+
+unsigned long beaconTask(void)
+{
+  // flash the LED now, the heartbeat turns it off again
+  ledOn = true;
+  digitalWrite(ledPin, HIGH);
+  tasks[HEARTBEAT_TASK].due = millis() + LED_FLASH;
+
+  sendCapabilities();
+  sendTaskReport();
+
+  return BEACON_PERIOD;
+}
+
+// sends the state collected since the window opened
+unsigned long coalesceTask(void)
+{
+  commands.closeWindow();
+
+  return TASK_SLEEP;
 }
 
-void periodicCapabilities()
+void handleCommand(uint32_t received)
 {
-  static unsigned long capabTimestamp = 0;
-  if(millis() - capabTimestamp > 60000)
+  for (uint8_t i = 0; i < COMMAND_LEN; i++)
+    packet[i] = response.getData(i);
+  packetReceived = received;
+  commands.handle(packet);
+}
+
+void SketchHost::scheduleCommit(uint16_t ms)
+{
+  tasks[COALESCE_TASK].due = millis() + ms;
+}
+
+void SketchHost::commandStarting(uint8_t command)
+{
+  if (command < 1 || command > STAT_COMMANDS)
+    return;
+
+  stats[command - 1].count++;
+  if (!pendingCommand)
   {
-    digitalWrite(ledPin, HIGH);
-    sendCapabilities();
-    digitalWrite(ledPin, LOW);
-    delay(100);
-    capabTimestamp = millis();
+    pendingCommand = command;
+    pendingReceived = packetReceived;
+    pendingEncode = halCycles();
+    pendingFrames = toyo.getFramesSent();
   }
 }
 
+void SketchHost::windowClosing(void)
+{
+  pendingEncode = halCycles();
+}
+
 void sendCapabilities(void)
 {               
   uber.sendValue("report", "airconditioner");
 }
 
-void sendState(Toyotomi &toyo)
+// one STATS_REPORT packet per command, commands 1 - STAT_COMMANDS if 0
+void SketchHost::sendStats(uint8_t command)
+{
+  for (uint8_t i = 1; i <= STAT_COMMANDS; i++)
+  {
+    if (command && command != i)
+      continue;
+    statsPayload[1] = i;
+    memcpy(statsPayload + 2, &stats[i - 1], sizeof(CommandStats));
+    xbee.send(statsTx);
+  }
+}
+
+void SketchHost::sendTrace(void)
+{
+  traceTx.setPayloadLength(1 + Toyotomi::dumpTrace(tracePayload + 1));
+  xbee.send(traceTx);
+}
+
+// TASK_REPORT, the worst run time of every task in us (4 bytes each),
+// takeAwakePermille() and getSkippedFrames() (2 bytes each), low byte first
+void sendTaskReport(void)
 {
-  uber.sendValue("ac_active", String(int(toyo.isPoweredOn())));
-  uber.sendValue("ac_temp", String((int)(toyo.getTemperature())));
-  uber.sendValue("ac_mode", String(toyo.getMode()));
-  uber.sendValue("ac_fanspeed", String(toyo.getFanSpeed()));
-  uber.sendValue("ac_timeron", String(toyo.getTimerOn()));
-  uber.sendValue("ac_timeroff", String(toyo.getTimerOff()));
-  uber.sendValue("ac_sleep", String(int(toyo.isSleepOn())));
+  uint16_t awake = Toyotomi::takeAwakePermille();
+  uint16_t skipped = toyo.getSkippedFrames();
+
+  for (uint8_t i = 0; i < TASKS; i++)
+    memcpy(taskPayload + 1 + 4 * i, &tasks[i].worstUs, 4);
+  memcpy(taskPayload + 1 + 4 * TASKS, &awake, 2);
+  memcpy(taskPayload + 3 + 4 * TASKS, &skipped, 2);
+  xbee.send(taskTx);
+}
+
+// STATE_REPORT, the CHANGED_* mask and the PackedState in one packet
+void SketchHost::sendPackedState(uint16_t changes, const PackedState &state)
+{
+  statePayload[1] = changes & 0xFF;
+  statePayload[2] = changes >> 8;
+  memcpy(statePayload + 3, &state, sizeof(state));
+  xbee.send(stateTx);
 }
 
+// one uberdust text value per changed field, with STRING_STATE_REPORT only
+void SketchHost::sendValue(const char *name, int value)
+{
+#ifdef STRING_STATE_REPORT
+  uber.sendValue(name, String(value));
+#endif
+}
@@ -9,26 +9,189 @@
 */
 
 
-#include <Arduino.h>
 #include <Toyotomi.h>
+#include <ToyotomiGroup.h>
+#ifdef SERIAL_DEBUG
+#include <ToyotomiRaw.h>
+#endif
+
+#ifdef TOYOTOMI_FRAME_TABLE
+
+/*
+ * Low 16 bits of the state word for every temperature index, mode and fan
+ * speed with both timers off, in the order (temp * (FAN + 1) + mode) *
+ * (HIGH_SP + 1) + fanSpeed. The high byte is always the DEFAULT_HEAD one.
+ * Evaluated entirely by the compiler.
+ */
+constexpr uint16_t _frameWord(const unsigned i)
+{
+    return (TEMP_MASK & tempMap[i / ((FAN + 1) * (HIGH_SP + 1))]) |
+           (MODE_MASK & modeMap[i / (HIGH_SP + 1) % (FAN + 1)]) |
+           (FANSPEED_MASK & fanSpeedMap[i % (HIGH_SP + 1)]) |
+           (TIMOFFTIM_MASK & timerOffMap[HOUR000]) |
+           (DEFAULT_MASK & DEFAULT_HEAD & 0x00FFFF);
+}
+
+#define FRAME_WORDS_5(i)   _frameWord(i), _frameWord(i + 1), _frameWord(i + 2), \
+                           _frameWord(i + 3), _frameWord(i + 4)
+#define FRAME_WORDS_25(i)  FRAME_WORDS_5(i), FRAME_WORDS_5(i + 5), FRAME_WORDS_5(i + 10), \
+                           FRAME_WORDS_5(i + 15), FRAME_WORDS_5(i + 20)
+#define FRAME_WORDS_125(i) FRAME_WORDS_25(i), FRAME_WORDS_25(i + 25), FRAME_WORDS_25(i + 50), \
+                           FRAME_WORDS_25(i + 75), FRAME_WORDS_25(i + 100)
+
+static constexpr uint16_t stateFrames[] PROGMEM = {
+    FRAME_WORDS_125(0), FRAME_WORDS_125(125), FRAME_WORDS_125(250)
+};
+
+static_assert(sizeof(stateFrames) / sizeof(stateFrames[0]) == FRAME_TABLE_LEN,
+              "stateFrames must cover every temperature, mode and fan speed");
+
+#endif
+
+#ifdef SERIAL_DEBUG
+
+// streams the raw timing record of every frame (ToyotomiRaw.h)
+struct IRSerialSink
+{
+    void operator()(const uint8_t _byte) const
+    {
+        Serial.write(_byte);
+    }
+};
+
+#endif
+
+#ifdef IR_ASYNC_TX
+
+/*
+ * Background transmitter, shared by all instances since there is only one
+ * Timer1/Timer2 pair. Each queued frame is played as a header, the data bits
+ * and a trailer (symbols 0 .. DEFAULT_DATA_LEN + 1), twice if repeated.
+ * Every symbol is a mark followed by a space, timed by the Timer1 compare
+ * match; the ISR gates the Timer2 carrier at each boundary.
+ */
+struct IRQueuedFrame
+{
+    uint8_t data[IR_FRAME_LEN];     // bit i in data[i / 8], LSB first
+    uint8_t passes;
+};
+
+static IRQueuedFrame _txQueue[IR_QUEUE_LEN];
+static volatile uint8_t _txHead = 0;
+static volatile uint8_t _txCount = 0;
+static uint8_t _txSymbol;
+static uint8_t _txPasses;
+static bool _txInMark;
+static volatile TransmitCallback _txDone = NULL;
+static volatile uint32_t _txIdleAt;     // halCycles() when the queue last ran empty
+
+static uint16_t _symbolMark(const uint8_t _symbol)
+{
+    return ToyotomiProtocol::mark(_symbol) * IR_UNIT_TICKS;
+}
+
+static uint16_t _symbolSpace(const IRQueuedFrame &_frame, const uint8_t _symbol)
+{
+    return ToyotomiProtocol::space(_frame.data, _symbol) * IR_UNIT_TICKS;
+}
+
+static void _txStartMark(void)
+{
+    halCarrierOn();
+    OCR1A = _symbolMark(_txSymbol) - 1;
+    _txInMark = true;
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+    uint8_t _tail = (_txHead + IR_QUEUE_LEN - _txCount) % IR_QUEUE_LEN;
+    
+    if (_txInMark)
+    {
+        halCarrierOff();
+        OCR1A = _symbolSpace(_txQueue[_tail], _txSymbol) - 1;
+        _txInMark = false;
+        return;
+    }
+    
+    if (++_txSymbol == ToyotomiProtocol::symbols)
+    {
+        _txSymbol = 0;
+        if (--_txPasses == 0)
+        {
+            _tail = (_tail + 1) % IR_QUEUE_LEN;
+            if (--_txCount == 0)
+            {
+                TIMSK1 &= ~_BV(OCIE1A);
+                TCCR1B = 0;
+                _txIdleAt = halCycles();
+                if (_txDone)
+                    _txDone();
+                return;
+            }
+            _txPasses = _txQueue[_tail].passes;
+        }
+    }
+    
+    _txStartMark();
+}
+
+#endif
+
+// one frame at a time, shared by every instance (of a thread on the host)
+HAL_THREAD_LOCAL uint8_t Toyotomi::dataInBuf[IR_FRAME_LEN];
+HAL_THREAD_LOCAL uint32_t Toyotomi::_sleptUs = 0;
+HAL_THREAD_LOCAL uint32_t Toyotomi::_awakeSince = 0;
+HAL_THREAD_LOCAL uint8_t Toyotomi::_commandTag = 0;
+#if IR_TRACE_LEN
+HAL_THREAD_LOCAL FrameTrace Toyotomi::_trace[IR_TRACE_LEN];
+HAL_THREAD_LOCAL uint8_t Toyotomi::_traceHead = 0;
+HAL_THREAD_LOCAL uint8_t Toyotomi::_traceCount = 0;
+#endif
 
 Toyotomi::Toyotomi(uint8_t _temperature, Mode _mode, FanSpeed _fanSpeed,
                    TimerTime _timerOn, TimerTime _timerOff, bool _active)
+    : Toyotomi(DEFAULT_LED_PIN, _temperature, _mode, _fanSpeed, _timerOn, _timerOff, _active)
 {
-    this->_setIRLEDPin(DEFAULT_LED_PIN);
+}
+
+Toyotomi::Toyotomi(uint8_t _IRLEDPin, uint8_t _temperature, Mode _mode, FanSpeed _fanSpeed,
+                   TimerTime _timerOn, TimerTime _timerOff, bool _active)
+    // every member has a value before the setters below compare against or send it
+    : _batchDepth(0), _batchWasOn(false), _batchNor(0), _batchInv(0), _batchFeatures(0), _batchSteps(0),
+      _temperature(DEFAULT_TEMP), _mode(DEFAULT_MODE), _timerOff(DEFAULT_TIMER), _timerOn(DEFAULT_TIMER),
+      _fanSpeed(DEFAULT_FANSPEED), _active(DEFAULT_POWER), _sleepState(DEFAULT_SLEEP), _swing(DEFAULT_SWING),
+      _turbo(DEFAULT_TURBO), _cleanAir(DEFAULT_CLEANAIR), _ledDisplay(DEFAULT_LEDDISP),
+      _IRLEDPin(DEFAULT_LED_PIN), _group(NULL), _uartOverruns(0), _changes(0), _lastFrame(),
+      _lastFrameValid(false), _lastFrameAt(0), _resendInterval(0), _skippedFrames(0), _framesSent(0),
+      _frameStart(0), _frameCycles(0)
+{
+    this->_setIRLEDPin(_IRLEDPin);
     this->_setTemperature(_temperature);
     this->_setMode(_mode);
     this->_setFanSpeed(_fanSpeed);
     this->_setTimerOn(_timerOn);
     this->_setTimerOff(_timerOff);
     this->_setActive(_active);
-    this->_setSleep(DEFAULT_SLEEP);
+    this->_changes = CHANGED_ALL;
 }
 
 Toyotomi::~Toyotomi(){}
 
+Toyotomi::Batch::Batch(Toyotomi &_unit) : _unit(_unit)
+{
+    this->_unit.beginUpdate();
+}
+
+Toyotomi::Batch::~Batch()
+{
+    this->_unit.commit();
+}
+
 uint8_t Toyotomi::_setTemperature(uint8_t _temperature)
 {
+    uint8_t _previous = this->getTemperature();
+    
     if (_temperature < MIN_TEMP)
         this->_temperature = MIN_TEMP;
     else if (_temperature > MAX_TEMP)
@@ -36,47 +199,44 @@ uint8_t Toyotomi::_setTemperature(uint8_t _temperature)
     else
         this->_temperature = _temperature;
     
+    if (this->getTemperature() != _previous)
+        this->_changes |= CHANGED_TEMP;
+    
     return this->_temperature;
 }
 
 
 uint8_t Toyotomi::setTemperature(uint8_t _temperature)
 {
-    long unsigned sendValNor, sendValInv;
-    
     if (this->getMode() == FAN)
         return this->_temperature;
     this->_setTemperature(_temperature);
     if (!this->isPoweredOn())
         return this->_temperature;
     
-    sendValNor = (TEMP_MASK & this->_tempMap(this->getTemperature())) |
-                 (MODE_MASK & this->_modeMap(this->getMode())) |
-                 (FANSPEED_MASK & this->_fanSpeedMap(this->getFanSpeed())) |
-                 (TIMOFFTIM_MASK & this->_timerOffMap(this->getTimerOff())) |
-                 (DEFAULT_MASK & DEFAULT_HEAD);
-
-    if (this->getTimerOn() == HOUR000 && this->getTimerOff() == HOUR000)
-        sendValInv = ~sendValNor;
-    else
-        sendValInv = (~sendValNor & INVERTED_MASK) |
-                     (sendValNor & TIMENCOM_MASK) |
-                     (ONTIMER_MASK & ONTIMERVAL) |
-                     (TIMONTIM_MASK & this->_timerOnMap(this->getTimerOn())) |
-                     (this->getTimerOn() == HOUR000 ? TIMONTIM_MASK & NOTIMONVAL : 0);
-                     
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendState();
 
     return this->_temperature;
 }
 
 Mode Toyotomi::_setMode(Mode _mode)
 {
+    Mode _previous = this->_mode;
+    uint8_t _temperature = this->getTemperature();
+    FanSpeed _fanSpeed = this->getFanSpeed();
+    
     if (_mode >= AUTO && _mode <= FAN)
         this->_mode = _mode;
     else
         this->_mode = DEFAULT_MODE;
+    
+    if (this->_mode != _previous)
+        this->_changes |= CHANGED_MODE;
+    // FAN reports no temperature, AUTO and DRY no fan speed
+    if (this->getTemperature() != _temperature)
+        this->_changes |= CHANGED_TEMP;
+    if (this->getFanSpeed() != _fanSpeed)
+        this->_changes |= CHANGED_FANSPEED;
 
     return this->_mode;
 }
@@ -84,29 +244,11 @@ Mode Toyotomi::_setMode(Mode _mode)
 
 Mode Toyotomi::setMode(Mode _mode)
 {
-    long unsigned sendValNor, sendValInv;
-    
     this->_setMode(_mode);
     if (!this->isPoweredOn())
         return this->_mode;
     
-    sendValNor = (TEMP_MASK & this->_tempMap(this->getTemperature())) |
-                 (MODE_MASK & this->_modeMap(this->getMode())) |
-                 (FANSPEED_MASK & this->_fanSpeedMap(this->getFanSpeed())) |
-                 (TIMOFFTIM_MASK & this->_timerOffMap(this->getTimerOff())) |
-                 (DEFAULT_MASK & DEFAULT_HEAD);
-
-    if (this->getTimerOn() == HOUR000 && this->getTimerOff() == HOUR000)
-        sendValInv = ~sendValNor;
-    else
-        sendValInv = (~sendValNor & INVERTED_MASK) |
-                     (sendValNor & TIMENCOM_MASK) |
-                     (ONTIMER_MASK & ONTIMERVAL) |
-                     (TIMONTIM_MASK & this->_timerOnMap(this->getTimerOn())) |
-                     (this->getTimerOn() == HOUR000 ? TIMONTIM_MASK & NOTIMONVAL : 0);
-
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendState();
     
     return this->_mode;
 }
@@ -114,11 +256,16 @@ Mode Toyotomi::setMode(Mode _mode)
 
 TimerTime Toyotomi::_setTimerOff(TimerTime _timerOff)
 {
+    TimerTime _previous = this->_timerOff;
+    
     if (_timerOff >= HOUR000 && _timerOff <= HOUR240)
         this->_timerOff = _timerOff;
     else
         this->_timerOff = DEFAULT_TIMER;
     
+    if (this->_timerOff != _previous)
+        this->_changes |= CHANGED_TIMEROFF;
+    
     if (this->_timerOff != HOUR000)
     {
         _setActive(true);
@@ -138,26 +285,8 @@ TimerTime Toyotomi::_setTimerOff(TimerTime _timerOff)
 
 TimerTime Toyotomi::setTimerOff(TimerTime _timerOff)
 {
-    long unsigned sendValNor, sendValInv;
-
     this->_setTimerOff(_timerOff);
-    sendValNor = (TEMP_MASK & this->_tempMap(this->getTemperature())) |
-                 (MODE_MASK & this->_modeMap(this->getMode())) |
-                 (FANSPEED_MASK & this->_fanSpeedMap(this->getFanSpeed())) |
-                 (TIMOFFTIM_MASK & this->_timerOffMap(this->getTimerOff())) |
-                 (DEFAULT_MASK & DEFAULT_HEAD);
-
-    if (this->getTimerOn() == HOUR000 && this->getTimerOff() == HOUR000)
-        sendValInv = ~sendValNor;
-    else
-        sendValInv = (~sendValNor & INVERTED_MASK) |
-                     (sendValNor & TIMENCOM_MASK) |
-                     (ONTIMER_MASK & ONTIMERVAL) |
-                     (TIMONTIM_MASK & this->_timerOnMap(this->getTimerOn())) |
-                     (this->getTimerOn() == HOUR000 ? TIMONTIM_MASK & NOTIMONVAL : 0);
-
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendState();
     
     return this->_timerOff;
 }
@@ -165,11 +294,16 @@ TimerTime Toyotomi::setTimerOff(TimerTime _timerOff)
 
 TimerTime Toyotomi::_setTimerOn(TimerTime _timerOn)
 {
+    TimerTime _previous = this->_timerOn;
+    
     if (_timerOn >= HOUR000 && _timerOn <= HOUR240)
         this->_timerOn = _timerOn;
     else
         this->_timerOn = DEFAULT_TIMER;
     
+    if (this->_timerOn != _previous)
+        this->_changes |= CHANGED_TIMERON;
+    
     if (this->_timerOn != HOUR000)
     {
         _setActive(true);
@@ -189,7 +323,6 @@ TimerTime Toyotomi::_setTimerOn(TimerTime _timerOn)
 
 TimerTime Toyotomi::setTimerOn(TimerTime _timerOn)
 {
-    long unsigned sendValNor, sendValInv;
     bool _timerOnOn, _timerOffOn;
     
     _timerOnOn = this->_timerOnIsOn();
@@ -202,23 +335,7 @@ TimerTime Toyotomi::setTimerOn(TimerTime _timerOn)
         return this->_timerOn;
     }
         
-    sendValNor = (TEMP_MASK & this->_tempMap(this->getTemperature())) |
-                 (MODE_MASK & this->_modeMap(this->getMode())) |
-                 (FANSPEED_MASK & this->_fanSpeedMap(this->getFanSpeed())) |
-                 (TIMOFFTIM_MASK & this->_timerOffMap(this->getTimerOff())) |
-                 (DEFAULT_MASK & DEFAULT_HEAD);
-
-    if (this->getTimerOn() == HOUR000 && this->getTimerOff() == HOUR000)
-        sendValInv = ~sendValNor;
-    else
-        sendValInv = (~sendValNor & INVERTED_MASK) |
-                     (sendValNor & TIMENCOM_MASK) |
-                     (ONTIMER_MASK & ONTIMERVAL) |
-                     (TIMONTIM_MASK & this->_timerOnMap(this->getTimerOn())) |
-                     (this->getTimerOn() == HOUR000 ? TIMONTIM_MASK & NOTIMONVAL : 0);
-
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendState();
     
     return this->_timerOn;
 }
@@ -226,6 +343,8 @@ TimerTime Toyotomi::setTimerOn(TimerTime _timerOn)
 
 FanSpeed Toyotomi::_setFanSpeed(FanSpeed _fanSpeed)
 {  
+    FanSpeed _previous = this->_fanSpeed;
+    
     if (_fanSpeed < NONE_SP || _fanSpeed > HIGH_SP)
         _fanSpeed = DEFAULT_SP;
         
@@ -245,35 +364,19 @@ FanSpeed Toyotomi::_setFanSpeed(FanSpeed _fanSpeed)
             break;
     }
     
+    if (this->_fanSpeed != _previous)
+        this->_changes |= CHANGED_FANSPEED;
+    
     return this->_fanSpeed;
 }
 
 FanSpeed Toyotomi::setFanSpeed(FanSpeed _fanSpeed)
 {
-    long unsigned sendValNor, sendValInv;
-    FanSpeed _curFanSpeed, _prevFanSpeed = this->_fanSpeed;
-    
     if (!this->isPoweredOn()|| this->_mode == AUTO || this->_mode == DRY)
         return this->_fanSpeed;
     
     this->_setFanSpeed(_fanSpeed);
-    sendValNor = (TEMP_MASK & this->_tempMap(this->getTemperature())) |
-                 (MODE_MASK & this->_modeMap(this->getMode())) |
-                 (FANSPEED_MASK & this->_fanSpeedMap(this->getFanSpeed())) |
-                 (TIMOFFTIM_MASK & this->_timerOffMap(this->getTimerOff())) |
-                 (DEFAULT_MASK & DEFAULT_HEAD);
-
-    if (this->getTimerOn() == HOUR000 && this->getTimerOff() == HOUR000)
-        sendValInv = ~sendValNor;
-    else
-        sendValInv = (~sendValNor & INVERTED_MASK) |
-                     (sendValNor & TIMENCOM_MASK) |
-                     (ONTIMER_MASK & ONTIMERVAL) |
-                     (TIMONTIM_MASK & this->_timerOnMap(this->getTimerOn())) |
-                     (this->getTimerOn() == HOUR000 ? TIMONTIM_MASK & NOTIMONVAL : 0);
-
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendState();
     
     return this->_fanSpeed;
 }
@@ -291,6 +394,94 @@ void Toyotomi::setState(uint8_t _temperature, Mode _mode, FanSpeed _fanSpeed)
     return;
 }
 
+void Toyotomi::beginUpdate()
+{
+    if (this->_batchDepth++)
+        return;
+    
+    // remember what the unit was last told, to skip a no-op commit
+    this->_batchWasOn = this->isPoweredOn();
+    this->_batchNor = this->_stateWord();
+    this->_batchInv = this->_invertedWord(this->_batchNor);
+    this->_batchFeatures = this->getPackedState().features;
+    this->_batchSteps = 0;
+}
+
+/*
+ * Sends the state the batch ended with, then the toggles made in it, so
+ * they reach a unit that already is in that state. Toggles that need the
+ * unit on are dropped, and their functions restored, if it ends off.
+ */
+bool Toyotomi::commit()
+{
+    bool _sent;
+    
+    if (!this->_batchDepth || --this->_batchDepth)
+        return false;
+    
+    _sent = this->_commitState();
+    
+    return this->_commitToggles() || _sent;
+}
+
+bool Toyotomi::_commitState()
+{
+    uint32_t sendValNor, sendValInv;
+    
+    if (!this->isPoweredOn())
+    {
+        if (!this->_batchWasOn)
+            return false;
+        this->powerOff();
+        return true;
+    }
+    
+    sendValNor = this->_stateWord();
+    sendValInv = this->_invertedWord(sendValNor);
+    if (this->_batchWasOn && sendValNor == this->_batchNor && sendValInv == this->_batchInv)
+        return false;
+    
+    return this->_sendFrame(sendValNor, sendValInv);
+}
+
+bool Toyotomi::_commitToggles()
+{
+    bool _on = this->isPoweredOn();
+    uint8_t _sent = 0;
+    
+    _sent += this->_commitToggle(this->_swing, PACKED_SWING, SWING, CHANGED_SWING, _on);
+    _sent += this->_commitToggle(this->_turbo, PACKED_TURBO, TURBO, CHANGED_TURBO, _on);
+    _sent += this->_commitToggle(this->_cleanAir, PACKED_CLEANAIR, CLEAN_AIR, CHANGED_CLEANAIR, _on);
+    _sent += this->_commitToggle(this->_ledDisplay, PACKED_LEDDISP, LED_DISPLAY, CHANGED_LEDDISP, true);
+    for (; this->_batchSteps; this->_batchSteps--)
+    {
+        if (!_on)
+            continue;
+        this->buttonAirDirection();
+        _sent++;
+    }
+    
+    return _sent;
+}
+
+// sends the toggle of a function changed in the batch, or takes the change back
+bool Toyotomi::_commitToggle(bool &_feature, const uint8_t _packed, const uint32_t sendValNor,
+                             const uint16_t _changed, const bool _allowed)
+{
+    bool _was = this->_batchFeatures & _packed;
+    
+    if (_feature == _was)
+        return false;
+    if (!_allowed)
+    {
+        this->_setFeature(_feature, _was, _changed);
+        return false;
+    }
+    
+    this->_sendToggle(sendValNor);
+    return true;
+}
+
 uint8_t Toyotomi::_getTemperature()
 {
     return this->_temperature;
@@ -446,6 +637,8 @@ void Toyotomi::buttonFanSpeed()
         case HIGH_SP:
             this->setFanSpeed(DEFAULT_SP);
             break;
+        case NONE_SP:       // AUTO and DRY have no fan speed to cycle
+            break;
     }
      
     return;
@@ -453,20 +646,52 @@ void Toyotomi::buttonFanSpeed()
 
 void Toyotomi::buttonSwing()
 {
-    long unsigned sendValNor, sendValInv;
-    
-    if (!this->isPoweredOn())
+    if (!this->_batchDepth && !this->isPoweredOn())
         return;
     
-    sendValNor = SWING;
-    sendValInv = ~sendValNor;
-    
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendToggle(SWING);
+    this->_setFeature(this->_swing, !this->_swing, CHANGED_SWING);
 
     return;
 }
 
+/*
+ * The absolute setters send the toggle code only when the tracked state
+ * differs, so asking for the current state costs nothing. They assume the
+ * unit is only ever toggled through this library.
+ */
+bool Toyotomi::setSwing(bool _swing)
+{
+    if (this->_swing != _swing)
+        this->buttonSwing();
+    
+    return this->_swing;
+}
+
+bool Toyotomi::setTurbo(bool _turbo)
+{
+    if (this->_turbo != _turbo)
+        this->buttonTurbo();
+    
+    return this->_turbo;
+}
+
+bool Toyotomi::setCleanAir(bool _cleanAir)
+{
+    if (this->_cleanAir != _cleanAir)
+        this->buttonCleanAir();
+    
+    return this->_cleanAir;
+}
+
+bool Toyotomi::setLedDisplay(bool _ledDisplay)
+{
+    if (this->_ledDisplay != _ledDisplay)
+        this->buttonLedDisplay();
+    
+    return this->_ledDisplay;
+}
+
 /*
 void Toyotomi::buttonSleep()
 {   
@@ -499,17 +724,23 @@ void Toyotomi::buttonTimerOff()
 }
 
 
+// steps the louvers to their next position, there is no state to track
 void Toyotomi::buttonAirDirection(void)
 {
     long unsigned sendValNor, sendValInv;
     
+    if (this->_batchDepth)
+    {
+        this->_batchSteps++;    // commit() steps them once the unit has its state
+        return;
+    }
     if (!this->isPoweredOn())
         return;
     
     sendValNor = AIR_DIRECTION;
-    sendValInv = ~sendValNor;
+    sendValInv = Protocol::check(sendValNor);
 
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
+    Protocol::encode(sendValNor, sendValInv, this->dataInBuf);
     this->sendData(this->dataInBuf, DEFAULT_DATA_LEN, false);
 
     return;
@@ -517,16 +748,11 @@ void Toyotomi::buttonAirDirection(void)
 
 void Toyotomi::buttonCleanAir(void)
 {
-    long unsigned sendValNor, sendValInv;
-    
-    if (!this->isPoweredOn())
+    if (!this->_batchDepth && !this->isPoweredOn())
         return;
     
-    sendValNor = CLEAN_AIR;
-    sendValInv = ~sendValNor;
-
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendToggle(CLEAN_AIR);
+    this->_setFeature(this->_cleanAir, !this->_cleanAir, CHANGED_CLEANAIR);
 
     return;
 }
@@ -534,91 +760,99 @@ void Toyotomi::buttonCleanAir(void)
 
 void Toyotomi::buttonLedDisplay(void)
 {
-    long unsigned sendValNor, sendValInv;
-    
-    sendValNor = LED_DISPLAY;
-    sendValInv = ~sendValNor;
-
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendToggle(LED_DISPLAY);
+    this->_setFeature(this->_ledDisplay, !this->_ledDisplay, CHANGED_LEDDISP);
 
     return;
 }
 
 void Toyotomi::buttonTurbo(void)
 {
-    long unsigned sendValNor, sendValInv;
-    
-    if (!this->isPoweredOn())
+    if (!this->_batchDepth && !this->isPoweredOn())
         return;
     
-    sendValNor = TURBO;
-    sendValInv = ~sendValNor;
-
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendToggle(TURBO);
+    this->_setFeature(this->_turbo, !this->_turbo, CHANGED_TURBO);
 
     return;
 }
         
 
-uint32_t Toyotomi::_tempMap(const uint8_t _temperature)
+uint32_t Toyotomi::_stateWord()
 {
-    uint32_t _rawData;
-    if (_temperature == NOTEMP)
-        _rawData = pgm_read_word(&tempMap[14]);
-    if (_temperature >= MIN_TEMP && _temperature <= MAX_TEMP)
-        _rawData = pgm_read_word(&tempMap[_temperature - MIN_TEMP]);
-    else //_temperature == NOTEMP
-        _rawData = pgm_read_word(&tempMap[0]);
+#ifdef TOYOTOMI_FRAME_TABLE
+    uint8_t _temperature = this->getTemperature();
+    uint8_t _tempIndex = 0;
+    
+    if (this->getTimerOff() == HOUR000)
+    {
+        if (_temperature >= MIN_TEMP && _temperature <= MAX_TEMP)
+            _tempIndex = _temperature - MIN_TEMP;
+        
+        return (DEFAULT_MASK & DEFAULT_HEAD & 0xFF0000) |
+               halReadWord(&stateFrames[(_tempIndex * (FAN + 1) + this->getMode()) * (HIGH_SP + 1) +
+                                          this->getFanSpeed()]);
+    }
+#endif
     
-    return _rawData;
+    return ToyotomiCodec::stateWord(this->_codecState());
 }
 
 
-uint32_t Toyotomi::_modeMap(const Mode _mode)
+uint32_t Toyotomi::_invertedWord(const uint32_t sendValNor)
 {
-    uint32_t _rawData;
-    if (_mode >= AUTO && _mode <= FAN)
-        _rawData = pgm_read_word(&modeMap[_mode]);
-    else
-        _rawData = pgm_read_word(&modeMap[AUTO]);
-            
-    return _rawData;
+    return ToyotomiCodec::checkWord(this->_codecState(), sendValNor);
 }
 
-uint32_t Toyotomi::_timerOffMap(const TimerTime _timerOff)
+
+ToyotomiState Toyotomi::_codecState()
 {
-    uint32_t _rawData;
-    if (_timerOff >= HOUR000 && _timerOff <= HOUR240)
-        _rawData = pgm_read_word(&timerOffMap[_timerOff]);
-    else
-        _rawData = pgm_read_word(&timerOffMap[HOUR000]);
+    ToyotomiState _state;
     
-    return _rawData;
+    _state.temperature = this->getTemperature();
+    _state.mode = this->getMode();
+    _state.fanSpeed = this->getFanSpeed();
+    _state.timerOn = this->getTimerOn();
+    _state.timerOff = this->getTimerOff();
+    
+    return _state;
 }
 
-uint32_t Toyotomi::_timerOnMap(const TimerTime _timerOn)
+
+void Toyotomi::_sendState(const bool _withTimers)
 {
-    uint32_t _rawData;
-    if (_timerOn >= HOUR000 && _timerOn <= HOUR240)
-        _rawData = pgm_read_word(&timerOnMap[_timerOn]);
-    else
-        _rawData = pgm_read_word(&timerOnMap[HOUR000]);
+    uint32_t sendValNor, sendValInv;
+    
+    if (this->_batchDepth)
+        return;     // commit() sends the final state
     
-    return _rawData;
+    sendValNor = this->_stateWord();
+    sendValInv = _withTimers ? this->_invertedWord(sendValNor) : Protocol::check(sendValNor);
+    this->_sendFrame(sendValNor, sendValInv);
 }
 
 
-uint32_t Toyotomi::_fanSpeedMap(const FanSpeed _fanSpeed)
+/*
+ * Sends a state or power off frame unless it is the one the unit got last.
+ * The same frame goes out again once the resend interval has passed, or
+ * after forceResend().
+ */
+bool Toyotomi::_sendFrame(const uint32_t sendValNor, const uint32_t sendValInv)
 {
-    uint32_t _rawData;
-    if (_fanSpeed >= NONE_SP && _fanSpeed <= HIGH_SP)
-        _rawData = pgm_read_word(&fanSpeedMap[_fanSpeed]);
-    else
-        _rawData = pgm_read_word(&fanSpeedMap[DEFAULT_SP]);
+    Protocol::encode(sendValNor, sendValInv, this->dataInBuf);
+    if (this->_lastFrameValid && !memcmp(this->dataInBuf, this->_lastFrame, IR_FRAME_LEN)
+        && !(this->_resendInterval && halMillis() - this->_lastFrameAt >= this->_resendInterval))
+    {
+        this->_skippedFrames++;
+        return false;
+    }
     
-    return _rawData;
+    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    memcpy(this->_lastFrame, this->dataInBuf, IR_FRAME_LEN);
+    this->_lastFrameValid = true;
+    this->_lastFrameAt = halMillis();
+    
+    return true;
 }
 
 
@@ -628,46 +862,64 @@ uint8_t Toyotomi::_getIRLEDPin()
 }
 
 
-void Toyotomi::_pulsesIR(long microsecs, uint8_t _IRLEDPin)
+void Toyotomi::_carrierBegin()
 {
-    while (microsecs > 0)
-    {
-        // 38 kHz is about 13 microseconds high and 13 microseconds low
-        digitalWrite(_IRLEDPin, HIGH);  // this takes about 5 microseconds to happen
-        delayMicroseconds(_VAR_DELAY);         // hang out for 8 microseconds
-        digitalWrite(_IRLEDPin, LOW);   // this also takes about 5 microseconds
-        delayMicroseconds(_VAR_DELAY);         // hang out for 8 microseconds
- 
-        // so 26 microseconds altogether
-        microsecs -= CYCLE_TIME;
-    }
-    
-    return;
+#ifdef IR_TIMER2_CARRIER
+    // Arduino's init() claims Timer2 for PWM after our constructor runs,
+    // so the carrier has to be (re)configured before every frame.
+    halCarrierBegin(IR_TIMER2_CS, IR_TIMER2_TOP);
+    halPinWrite(IR_TIMER2_PIN, LOW);    // pin level while the carrier is gated off
+#endif
+}
+
+
+// blocking transmission of a frame, backends without an IR LED override it
+void Toyotomi::_transmit(const uint8_t _data[], const uint8_t _passes)
+{
+    this->_carrierBegin();
+    IREngine<Protocol>::send(*this, _data, _passes);
 }
 
 
-void Toyotomi::_sendHIGH(uint8_t _IRLEDPin)
+void Toyotomi::_carrierPeriods(uint8_t periods, uint8_t _IRLEDPin)
 {
-    this->_pulsesIR(CYCLE_TIME * PULSE_CYCLES, _IRLEDPin);
-    delayMicroseconds(CYCLE_TIME * PULSE_CYCLES * 3);
+#ifndef IR_TIMER2_CARRIER
+    static_assert(IR_HALF_PERIOD_CYCLES > IR_PIN_WRITE_CYCLES + IR_LOOP_CYCLES,
+                  "F_CPU is too slow for a digitalWrite() carrier, use ToyotomiPin or IR_TIMER2_CARRIER");
+    
+    for (; periods; periods--)
+    {
+        // one carrier period, 26 microseconds at 38 kHz
+        halPinWrite(_IRLEDPin, HIGH);
+        halDelayCycles<IR_CARRIER_DELAY(IR_PIN_WRITE_CYCLES)>();
+        halPinWrite(_IRLEDPin, LOW);
+        halDelayCycles<IR_CARRIER_DELAY(IR_PIN_WRITE_CYCLES + IR_LOOP_CYCLES)>();
+        halLoopCycles<IR_LOOP_CYCLES>();
+    }
+#endif
 }
 
 
-void Toyotomi::_sendLOW(uint8_t _IRLEDPin)
+// closes a halIrqOff() section, counting a serial overrun that happened in it
+void Toyotomi::_criticalEnd(void)
 {
-    this->_pulsesIR(CYCLE_TIME * PULSE_CYCLES, _IRLEDPin);
-    delayMicroseconds(CYCLE_TIME * PULSE_CYCLES);    
+    if (halUartOverrun())
+        this->_uartOverruns++;
+    halIrqOn();
 }
 
 
 uint8_t Toyotomi::_setIRLEDPin(uint8_t _IRLEDPin)
 {
+#ifdef IR_TIMER2_CARRIER
+    _IRLEDPin = IR_TIMER2_PIN;
+#endif
     if (_IRLEDPin >= 8 && _IRLEDPin <= 13)
         this->_IRLEDPin = _IRLEDPin;
     else
         this->_IRLEDPin = DEFAULT_LED_PIN;
     
-    pinMode(this->_IRLEDPin, OUTPUT);
+    halPinOutput(this->_IRLEDPin);
     return this->_IRLEDPin;
 }
 
@@ -675,117 +927,71 @@ uint8_t Toyotomi::_setIRLEDPin(uint8_t _IRLEDPin)
 
 void Toyotomi::sendData(const uint8_t dataIn[], const uint8_t dataLength, const bool repeat)
 {
-    uint8_t _IRLEDPin = _getIRLEDPin();
+    _traceFrame(dataIn);
+    if (this->_group && this->_group->_capture(this, dataIn, repeat))
+        return;     // played with the rest of the group
     
-    cli();
+    this->_sendNow(dataIn, repeat);
+}
+
+
+// hands a frame to the transmitter, untraced; the group plays captured frames through it
+void Toyotomi::_sendNow(const uint8_t dataIn[], const bool repeat)
+{
+    this->_framesSent++;
+    this->_frameStart = halCycles();
+#ifdef IR_ASYNC_TX
+    IRQueuedFrame *_frame;
     
-//     delayMicroseconds(50);
-    if (repeat)
-    {
-        this->_pulsesIR(CYCLE_TIME * PULSE_CYCLES * 8, _IRLEDPin);
-        delayMicroseconds(CYCLE_TIME * PULSE_CYCLES * 8);
+    while (_txCount == IR_QUEUE_LEN)
+        Toyotomi::idle();       // the ISR frees a slot
     
-        for (unsigned i = 0; i < dataLength; i++)
-        {
-            if (!dataIn[i])
-                this->_sendLOW(_IRLEDPin);
-            else
-                this->_sendHIGH(_IRLEDPin);
-        }
-
-//         this->_pulsesIR(CYCLE_TIME * PULSE_CYCLES, _IRLEDPin);
-        this->_sendLOW(_IRLEDPin);
-        delayMicroseconds(CYCLE_TIME * PULSE_CYCLES * 9);
-        
-        this->_pulsesIR(CYCLE_TIME * PULSE_CYCLES * 8, _IRLEDPin);
-        delayMicroseconds(CYCLE_TIME * PULSE_CYCLES * 8);
+    _frame = &_txQueue[_txHead];
+    memcpy(_frame->data, dataIn, IR_FRAME_LEN);
+    _frame->passes = repeat ? 2 : 1;
     
-        for (unsigned i = 0; i < dataLength; i++)
-        {
-            if (!dataIn[i])
-                this->_sendLOW(_IRLEDPin);
-            else
-                this->_sendHIGH(_IRLEDPin);
-        }
-
-        this->_sendLOW(_IRLEDPin);
-//         this->_pulsesIR(CYCLE_TIME * PULSE_CYCLES, _IRLEDPin);
-        delayMicroseconds(CYCLE_TIME * PULSE_CYCLES * 9);
-    }
-    else
+    halIrqOff();
+    _txHead = (_txHead + 1) % IR_QUEUE_LEN;
+    if (_txCount++ == 0)
     {
-        this->_pulsesIR(CYCLE_TIME * PULSE_CYCLES * 8, _IRLEDPin);
-        delayMicroseconds(CYCLE_TIME * PULSE_CYCLES * 8);
-    
-        for (unsigned i = 0; i < dataLength; i++)
-        {
-            if (!dataIn[i])
-                this->_sendLOW(_IRLEDPin);
-            else
-                this->_sendHIGH(_IRLEDPin);
-        }
-
-        this->_sendLOW(_IRLEDPin);
-//         this->_pulsesIR(CYCLE_TIME * PULSE_CYCLES, _IRLEDPin);
-        delayMicroseconds(CYCLE_TIME * PULSE_CYCLES * 9);
+        this->_carrierBegin();
+        _txSymbol = 0;
+        _txPasses = _frame->passes;
+        TCCR1A = 0;
+        TCCR1B = _BV(WGM12) | IR_TIMER1_CS;   // CTC, TOP = OCR1A
+        TCNT1 = 0;
+        _txStartMark();
+        TIFR1 = _BV(OCF1A);
+        TIMSK1 |= _BV(OCIE1A);
     }
-//     delay(65);
-    
-    sei();
+    halIrqOn();
+#else
+    this->_transmit(dataIn, repeat ? 2 : 1);
+    this->_frameCycles = halCycles() - this->_frameStart;
+#endif
 #ifdef SERIAL_DEBUG
-    this->sendToSerial(dataIn, dataLength, repeat);
+    IRRaw::encode<Protocol>(dataIn, repeat ? 2 : 1, IRSerialSink());
 #endif
 }
 
 
-void Toyotomi::sendDataNoHeaders(const uint8_t dataIn[], const uint8_t dataLength)
+void Toyotomi::sendDataNoHeaders(const uint8_t dataIn[], const uint8_t dataLength, const uint8_t firstBit)
 {
-    uint8_t _IRLEDPin = _getIRLEDPin();
+    while (this->isTransmitting())
+        Toyotomi::idle();
+    this->_carrierBegin();
     
-    cli();
-    
-    //delayMicroseconds(CYCLE_TIME * PULSE_CYCLES * 8);
-    
-    for (unsigned i = 0; i < dataLength; i++)
-    {
-        if (!dataIn[i])
-            this->_sendLOW(_IRLEDPin);
-        else
-            this->_sendHIGH(_IRLEDPin);
-    }
-    
-    this->_sendLOW(_IRLEDPin);
-    delayMicroseconds(CYCLE_TIME * PULSE_CYCLES * 9);
-    
-    sei();
+    for (uint8_t i = 0; i < dataLength; i++)
+        IREngine<Protocol>::symbol(*this, dataIn, firstBit + i + 1);
+    IREngine<Protocol>::symbol(*this, dataIn, Protocol::symbols - 1);
 }
 
 
 
-void Toyotomi::_createByteArray(const uint32_t inputHex, const uint32_t inputHexInv, uint8_t dataIn[], const uint8_t dataLength)
-{
-    for (unsigned i = 0; i < dataLength/2; i++)
-    {
-         dataIn[i % 8 + 16*(i / 8)] = (inputHex >> ((dataLength / 2) - ((i / 8) * 8) - (8 - i % 8))) & 1;
-         dataIn[i % 8 + 16*(i / 8) + 8] = (inputHexInv >> ((dataLength / 2) - ((i / 8) * 8) - (8 - i % 8))) & 1;
-    }
-}
-
 void Toyotomi::powerOn()
 {
-    long unsigned sendValNor, sendValInv;
     this->_setActive(true);
-    
-    sendValNor = (TEMP_MASK & this->_tempMap(this->getTemperature())) |
-                 (MODE_MASK & this->_modeMap(this->getMode())) |
-                 (FANSPEED_MASK & this->_fanSpeedMap(this->getFanSpeed())) |
-                 (TIMOFFTIM_MASK & this->_timerOffMap(this->getTimerOff())) |
-                 (DEFAULT_MASK & DEFAULT_HEAD);
-
-    sendValInv = ~sendValNor;
-
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendState(false);
 
     return;
 }
@@ -795,12 +1001,13 @@ void Toyotomi::powerOff()
     long unsigned sendValNor, sendValInv;
     
     this->_setActive(false);
+    if (this->_batchDepth)
+        return;
     
     sendValNor = POWER_OFF;
-    sendValInv = ~sendValNor;
+    sendValInv = Protocol::check(sendValNor);
 
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
-    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+    this->_sendFrame(sendValNor, sendValInv);
 
     return;
 }
@@ -813,13 +1020,36 @@ bool Toyotomi::_setActive(const bool _active)
         this->_setTimerOff(HOUR000);
         this->_setTimerOn(HOUR000);
     }
+    if (this->_active != _active)
+        this->_changes |= CHANGED_ACTIVE;
     this->_active = _active;
     
     return this->_active;
 }
 
+// the toggle codes carry no state, the unit flips the function itself
+void Toyotomi::_sendToggle(const uint32_t sendValNor)
+{
+    if (this->_batchDepth)
+        return;     // commit() sends it after the state
+    
+    Protocol::encode(sendValNor, Protocol::check(sendValNor), this->dataInBuf);
+    this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
+}
+
+bool Toyotomi::_setFeature(bool &_feature, const bool _on, const uint16_t _changed)
+{
+    if (_feature != _on)
+        this->_changes |= _changed;
+    _feature = _on;
+    
+    return _feature;
+}
+
 bool Toyotomi::_setSleep(const bool _sleepState)
 {
+    if (this->_sleepState != _sleepState)
+        this->_changes |= CHANGED_SLEEP;
     this->_sleepState = _sleepState;
     
     return this->_sleepState;
@@ -829,35 +1059,20 @@ bool Toyotomi::_setSleep(const bool _sleepState)
 bool Toyotomi::setSleep(bool _sleepState)
 {
     long unsigned sendValNor, sendValInv;
-    uint8_t tempVal;
-    unsigned i;
     
     if (!this->isPoweredOn())
         return this->_sleepState;
     
     this->_setSleep(_sleepState);
     
-    sendValNor = (TEMP_MASK & this->_tempMap(this->getTemperature())) |
-                 (MODE_MASK & this->_modeMap(this->getMode())) |
-                 (FANSPEED_MASK & this->_fanSpeedMap(this->getFanSpeed())) |
-                 (TIMOFFTIM_MASK & this->_timerOffMap(this->getTimerOff())) |
-                 (DEFAULT_MASK & DEFAULT_HEAD);
-
-    if (this->getTimerOn() == HOUR000 && this->getTimerOff() == HOUR000)
-        sendValInv = ~sendValNor;
-    else
-        sendValInv = (~sendValNor & INVERTED_MASK) |
-                     (sendValNor & TIMENCOM_MASK) |
-                     (ONTIMER_MASK & ONTIMERVAL) |
-                     (TIMONTIM_MASK & this->_timerOnMap(this->getTimerOn())) |
-                     (this->getTimerOn() == HOUR000 ? TIMONTIM_MASK & NOTIMONVAL : 0);
-                         
-    this->_createByteArray(sendValNor, sendValInv, this->dataInBuf, DEFAULT_DATA_LEN);
+    sendValNor = this->_stateWord();
+    sendValInv = this->_invertedWord(sendValNor);
+    Protocol::encode(sendValNor, sendValInv, this->dataInBuf);
      
     if (!this->_sleepState)
         this->sendData(this->dataInBuf, DEFAULT_DATA_LEN);
     else
-        this->sendDataNoHeaders(&this->dataInBuf[1], DEFAULT_DATA_LEN - 1);
+        this->sendDataNoHeaders(this->dataInBuf, DEFAULT_DATA_LEN - 1, 1);
       
     return this->_sleepState;
 }
@@ -869,6 +1084,223 @@ bool Toyotomi::isSleepOn(void)
 }
 
 
+bool Toyotomi::isSwingOn(void)
+{
+    return this->_swing;
+}
+
+bool Toyotomi::isTurboOn(void)
+{
+    return this->_turbo;
+}
+
+bool Toyotomi::isCleanAirOn(void)
+{
+    return this->_cleanAir;
+}
+
+bool Toyotomi::isLedDisplayOn(void)
+{
+    return this->_ledDisplay;
+}
+
+
+PackedState Toyotomi::getPackedState(void)
+{
+    PackedState _state;
+    
+    _state.flags = (this->_active ? PACKED_ACTIVE : 0) | (this->_sleepState ? PACKED_SLEEP : 0) |
+                   (this->_mode << PACKED_MODE_SHIFT) | this->getFanSpeed();
+    _state.temperature = this->getTemperature() & PACKED_TEMP;
+    _state.timerOn = this->_timerOn;
+    _state.timerOff = this->_timerOff;
+    _state.features = (this->_swing ? PACKED_SWING : 0) | (this->_turbo ? PACKED_TURBO : 0) |
+                      (this->_cleanAir ? PACKED_CLEANAIR : 0) | (this->_ledDisplay ? PACKED_LEDDISP : 0);
+    
+    return _state;
+}
+
+
+// CHANGED_* bits of the fields set since the previous call
+uint16_t Toyotomi::takeChanges(void)
+{
+    uint16_t _taken = this->_changes;
+    
+    this->_changes = 0;
+    return _taken;
+}
+
+
+bool Toyotomi::isTransmitting()
+{
+#ifdef IR_ASYNC_TX
+    return _txCount != 0;
+#else
+    return false;
+#endif
+}
+
+
+void Toyotomi::onTransmitDone(TransmitCallback _callback)
+{
+#ifdef IR_ASYNC_TX
+    _txDone = _callback;
+#endif
+}
+
+
+// sends the current state again even if the unit should already have it
+void Toyotomi::forceResend()
+{
+    this->_lastFrameValid = false;
+    if (this->isPoweredOn())
+        this->_sendState();
+    else
+        this->powerOff();
+}
+
+
+// 0 never sends an unchanged frame again
+void Toyotomi::setResendInterval(uint32_t _ms)
+{
+    this->_resendInterval = _ms;
+}
+
+
+// state frames not sent because the unit already had them
+uint16_t Toyotomi::getSkippedFrames()
+{
+    return this->_skippedFrames;
+}
+
+
+// frames handed to the transmitter, grouped sends excluded
+uint16_t Toyotomi::getFramesSent()
+{
+    return this->_framesSent;
+}
+
+
+uint32_t Toyotomi::getLastFrameStart()
+{
+    return this->_frameStart;
+}
+
+
+// halCycles() from handing over the last frame until the transmitter was idle, 0 until then
+uint32_t Toyotomi::getLastFrameCycles()
+{
+#ifdef IR_ASYNC_TX
+    if (this->isTransmitting())
+        return 0;
+    
+    return _txIdleAt - this->_frameStart;
+#else
+    return this->_frameCycles;
+#endif
+}
+
+
+/*
+ * Sleeps in IDLE until the next interrupt: a received character, a Timer1
+ * edge of the background transmitter or the millis() tick. The sketch calls
+ * it when it has nothing to do, the library while it waits on the
+ * transmitter, so with IR_ASYNC_TX the CPU also sleeps during marks and
+ * spaces.
+ */
+void Toyotomi::idle()
+{
+    uint32_t _start = halMicros();
+    
+    halSleep();
+    _sleptUs += halMicros() - _start;
+}
+
+
+// tags the frames sent from now on in the trace, e.g. with the command that caused them
+void Toyotomi::setCommandTag(const uint8_t _tag)
+{
+    _commandTag = _tag;
+}
+
+
+void Toyotomi::_traceFrame(const uint8_t _frame[])
+{
+#if IR_TRACE_LEN
+    FrameTrace &_entry = _trace[_traceHead];
+    
+    _entry.at = halMillis();
+    memcpy(_entry.frame, _frame, IR_FRAME_LEN);
+    _entry.tag = _commandTag;
+    _traceHead = (_traceHead + 1) % IR_TRACE_LEN;
+    if (_traceCount < IR_TRACE_LEN)
+        _traceCount++;
+#endif
+}
+
+
+/*
+ * Writes the traced frames, oldest first, into _out as IR_TRACE_ENTRY_BYTES
+ * entries (up to IR_TRACE_LEN of them) and returns the bytes written. The
+ * layout is fixed, so a trace from the board and one from a host build
+ * read the same.
+ */
+uint8_t Toyotomi::dumpTrace(uint8_t _out[])
+{
+#if IR_TRACE_LEN
+    uint8_t _first = (_traceHead + IR_TRACE_LEN - _traceCount) % IR_TRACE_LEN;
+    
+    for (uint8_t i = 0; i < _traceCount; i++)
+    {
+        const FrameTrace &_entry = _trace[(_first + i) % IR_TRACE_LEN];
+        
+        for (uint8_t _byte = 0; _byte < 4; _byte++)
+            *_out++ = _entry.at >> (8 * _byte);
+        memcpy(_out, _entry.frame, IR_FRAME_LEN);
+        _out += IR_FRAME_LEN;
+        *_out++ = _entry.tag;
+    }
+    
+    return _traceCount * IR_TRACE_ENTRY_BYTES;
+#else
+    return 0;
+#endif
+}
+
+
+// permille of the time awake since the last call, which has to be less than an hour ago
+uint16_t Toyotomi::takeAwakePermille()
+{
+    uint32_t _elapsed = halMillis() - _awakeSince;
+    uint32_t _asleep = _elapsed ? _sleptUs / _elapsed : 0;     // us per ms
+    
+    _awakeSince += _elapsed;
+    _sleptUs = 0;
+    
+    return _asleep < 1000 ? 1000 - _asleep : 0;
+}
+
+
+// moves the IR LED, pins 8 - 13 only
+uint8_t Toyotomi::setIRLEDPin(uint8_t _IRLEDPin)
+{
+    return this->_setIRLEDPin(_IRLEDPin);
+}
+
+
+uint8_t Toyotomi::getIRLEDPin()
+{
+    return this->_getIRLEDPin();
+}
+
+
+// serial receive overruns seen while the carrier held interrupts off
+uint16_t Toyotomi::getUartOverruns()
+{
+    return this->_uartOverruns;
+}
+
+
 bool Toyotomi::_timerOnIsOn()
 {
     if (this->getTimerOn() == HOUR000 && this->getTimerOff() == HOUR000)
@@ -885,42 +1317,3 @@ bool Toyotomi::_timerOffIsOn()
     else
         return true;
 }
-
-#ifdef SERIAL_DEBUG
-
-void Toyotomi::sendToSerial(const uint8_t dataIn[], const uint8_t dataLength, const bool repeat)
-{
-    Serial.print("int IRsignal[] = {\n");
-    Serial.print("// ON, OFF (in 10's of microseconds)\n");
-    uint8_t repeatCount = (repeat == true ? 2 : 1);
-    for (uint8_t j = 0; j < repeatCount; j++)
-    {
-        Serial.print("\t"); // tab
-        Serial.print(8 * 53, DEC);
-        Serial.print(", ");
-        Serial.print(8 * 53, DEC);
-        Serial.print(",\n");
-        for (uint8_t i = 0; i < dataLength; i++)
-        {
-            Serial.print("\t"); // tab
-            Serial.print(1 * 53, DEC);
-            Serial.print(", ");
-            if (dataIn[i])
-                Serial.print(3 * 53, DEC);
-            else
-                Serial.print(1 * 53, DEC);
-            Serial.print(",\n");
-        }
-        if (j < repeatCount - 1)
-        {
-            Serial.print("\t"); // tab
-            Serial.print(1 * 53, DEC);
-            Serial.print(", ");
-            Serial.print(10 * 53, DEC);
-            Serial.print(",\n");
-        }
-    }
-    Serial.print("\t53, 0};\n");
-}
-
-#endif
\ No newline at end of file
@@ -11,73 +11,69 @@
 #ifndef TOYOTOMI_H
 #define TOYOTOMI_H
 
-#include <Arduino.h>
-#include <avr/pgmspace.h>
+#include "ToyotomiHal.h"
+#include "ToyotomiProtocol.h"
+#include "ToyotomiCodec.h"
 
-#define CLK_8MHZ
+#define IR_CLOCK_RATE    38000L
+
+/*
+ * All timing is derived from F_CPU, so the library builds unchanged for 8,
+ * 12, 16 and 20 MHz boards. The software carrier waits a whole number of
+ * CPU cycles per half period, minus the cycles its pin writes and loop take.
+ */
+#define IR_HALF_PERIOD_CYCLES ((F_CPU + IR_CLOCK_RATE) / (2L * IR_CLOCK_RATE))
+#define IR_CARRIER_HZ         (F_CPU / (2L * IR_HALF_PERIOD_CYCLES))
+#define IR_CLOCK_TOLERANCE    2         // percent
+
+#ifndef IR_PIN_WRITE_CYCLES
+#define IR_PIN_WRITE_CYCLES   56        // digitalWrite() on a PWM-less pin
+#endif
+#define IR_PORT_WRITE_CYCLES  2         // sbi/cbi
+#define IR_MASK_WRITE_CYCLES  3         // in, or/and, out
+#define IR_LOOP_CYCLES        8         // period counter and branch
+
+// half period left to wait after _overhead cycles of pin writes and loop
+#define IR_CARRIER_DELAY(_overhead) \
+    (IR_HALF_PERIOD_CYCLES > (_overhead) ? IR_HALF_PERIOD_CYCLES - (_overhead) : 0)
+
+static_assert((IR_CARRIER_HZ > IR_CLOCK_RATE ? IR_CARRIER_HZ - IR_CLOCK_RATE : IR_CLOCK_RATE - IR_CARRIER_HZ) * 100
+              <= IR_CLOCK_TOLERANCE * IR_CLOCK_RATE, "F_CPU cannot produce the IR carrier within tolerance");
 
-#ifdef  CLK_8MHZ
-#define _VAR_DELAY            2
+/*
+ * Uncomment to generate the IR carrier with Timer2 instead of toggling the
+ * IR LED in software. The carrier is output on OC2A (digital pin 11) and the
+ * library only gates it on and off for marks and spaces.
+ */
+//#define IR_TIMER2_CARRIER
+
+#define IR_TIMER2_PIN    11
+
+#if (F_CPU / (2L * IR_CLOCK_RATE)) <= 256
+#define IR_TIMER2_PRESCALE 1
+#define IR_TIMER2_CS       _BV(CS20)
 #else
-#define _VAR_DELAY            8
+#define IR_TIMER2_PRESCALE 8
+#define IR_TIMER2_CS       _BV(CS21)
 #endif
 
+// CTC mode toggles OC2A twice per period: f = F_CPU / (2 * N * (1 + OCR2A))
+#define IR_TIMER2_TOP    ((F_CPU / IR_TIMER2_PRESCALE + IR_CLOCK_RATE) / (2L * IR_CLOCK_RATE) - 1)
 
-#define IR_CLOCK_RATE    38000L
+/*
+ * Uncomment to transmit in the background. Frames are queued and played out
+ * by the Timer1 compare interrupt, so the setters return immediately.
+ * Requires IR_TIMER2_CARRIER.
+ */
+//#define IR_ASYNC_TX
+
+#if defined(IR_ASYNC_TX) && !defined(IR_TIMER2_CARRIER)
+#error "IR_ASYNC_TX needs the Timer2 carrier (IR_TIMER2_CARRIER)"
+#endif
 
-#define DEFAULT_MASK   0xFF8000
-#define TEMP_MASK      0x00000F
-#define MODE_MASK      0x000030
-#define FANSPEED_MASK  0x000700
-#define COMMAND_MASK   0xFFFFFF
-#define LASTKEY_MASK   0x0000E0
-#define TIMENCOM_MASK  0x000001
-#define TIMONTIM_MASK  0x0000FE
-#define TIMOFFTIM_MASK 0x0078C0
-#define ONTIMER_MASK   0x000080
-#define INVERTED_MASK  0xFFFF00
-
-#define DEFAULT_HEAD   0x4D8000
-#define POWER_OFF      0x4DDE07
-#define AIR_DIRECTION  0x4DF007
-#define SWING          0x4DD607
-#define CLEAN_AIR      0xADAFC5
-#define LED_DISPLAY    0xADAFA5
-#define TURBO          0xADAF45
-#define SLEEP          0x647EA0
-
-#define ONTIMERVAL     0x000080
-#define NOTIMONVAL     0x0000FE
-
-
-#define NOTEMP         0
-
-enum Mode      { AUTO, COOL, DRY, HEAT, FAN };
-enum FanSpeed  { NONE_SP, DEFAULT_SP, LOW_SP, MED_SP, HIGH_SP };
-enum TimerTime { HOUR000, HOUR005, HOUR010, HOUR015, HOUR020, HOUR025, HOUR030, HOUR035, HOUR040,
-                 HOUR045, HOUR050, HOUR055, HOUR060, HOUR065, HOUR070, HOUR075, HOUR080, HOUR085,
-                 HOUR090, HOUR095, HOUR100, HOUR110, HOUR120, HOUR130, HOUR140, HOUR150, HOUR160,
-                 HOUR170, HOUR180, HOUR190, HOUR200, HOUR210, HOUR220, HOUR230, HOUR240 };
-
-const prog_uint32_t tempMap[] PROGMEM     = { 0x000000, 0x000008, 0x00000C, 0x000004, 0x000006,
-                                              0x00000E, 0x00000A, 0x000002, 0x000003, 0x00000B,
-                                              0x000009, 0x000001, 0x000005, 0x00000D, 0x000007 };
-const prog_uint32_t modeMap[] PROGMEM     = { 0x000010, 0x000000, 0x000020, 0x000030, 0x000020 };
-const prog_uint32_t fanSpeedMap[] PROGMEM = { 0x000000, 0x000500, 0x000100, 0x000200, 0x000400 };
-const prog_uint32_t timerOnMap[] PROGMEM  = { 0x000040, 0x000000, 0x000040, 0x000020, 0x000060,
-                                              0x000010, 0x000050, 0x000030, 0x000070, 0x000008,
-                                              0x000048, 0x000028, 0x000068, 0x000018, 0x000058,
-                                              0x000038, 0x000078, 0x000004, 0x000044, 0x000024,
-                                              0x000064, 0x000054, 0x000074, 0x00004c, 0x00006c,
-                                              0x00005c, 0x00007c, 0x000042, 0x000062, 0x000052,
-                                              0x000072, 0x00004a, 0x00006a, 0x00005a, 0x00007a };     
-const prog_uint32_t timerOffMap[] PROGMEM = { 0x007800, 0x000000, 0x004000, 0x002000, 0x006000,
-                                              0x001000, 0x005000, 0x003000, 0x007000, 0x000800,
-                                              0x004800, 0x002800, 0x006800, 0x001800, 0x005800,
-                                              0x003800, 0x007800, 0x000080, 0x004080, 0x002080,
-                                              0x006080, 0x005080, 0x007080, 0x004880, 0x006880,
-                                              0x005880, 0x007880, 0x004040, 0x006040, 0x005040,
-                                              0x007040, 0x004840, 0x006840, 0x005840, 0x007840 };
+#define IR_QUEUE_LEN     4
+#define IR_TIMER1_CS     _BV(CS11)
+#define IR_TIMER1_PRESCALE 8
 
 #define DEFAULT_TEMP     20
 #define DEFAULT_MODE     AUTO
@@ -85,23 +81,117 @@ const prog_uint32_t timerOffMap[] PROGMEM = { 0x007800, 0x000000, 0x004000, 0x00
 #define DEFAULT_TIMER    HOUR000
 #define DEFAULT_POWER    false
 #define DEFAULT_SLEEP    false
+#define DEFAULT_SWING    false
+#define DEFAULT_TURBO    false
+#define DEFAULT_CLEANAIR false
+#define DEFAULT_LEDDISP  true
+
 
-#define MIN_TEMP         17
-#define MAX_TEMP         30
+/*
+ * Uncomment to look the no-timer state frames up in a table built at compile
+ * time instead of assembling them from the maps on every call. The
+ * table covers every temperature, mode and fan speed and costs
+ * FRAME_TABLE_LEN * 2 bytes of flash.
+ */
+//#define TOYOTOMI_FRAME_TABLE
 
+#define FRAME_TABLE_TEMPS (sizeof(tempMap) / sizeof(tempMap[0]))
+#define FRAME_TABLE_LEN   (FRAME_TABLE_TEMPS * (FAN + 1) * (HIGH_SP + 1))
 
 #define DEFAULT_LED_PIN  8
-#define DEFAULT_DATA_LEN 48
-#define CYCLE_TIME       26
-#define PULSE_CYCLES     21
+
+/*
+ * Uncomment to stream the raw timing of every frame over Serial in the
+ * ToyotomiRaw.h format (about 70 bytes per frame); extras/raw turns it into
+ * Pronto hex and LIRC raw codes. Serial must not be the radio.
+ */
+//#define SERIAL_DEBUG
+
+// frames kept by the trace, 0 leaves it out
+#ifndef IR_TRACE_LEN
+#define IR_TRACE_LEN     8
+#endif
+
+#include "ToyotomiEngine.h"
+
+// one protocol time unit (CYCLE_TIME * PULSE_CYCLES us) in CPU cycles and Timer1 ticks
+#define IR_UNIT_CYCLES   (IREngine<ToyotomiProtocol>::unitCycles)
+#define IR_UNIT_TICKS    (IREngine<ToyotomiProtocol>::unitTicks)
+
+typedef void (*TransmitCallback)(void);
+
+/*
+ * The whole shadow state in five bytes, as sent in the state report:
+ * flags holds the power and sleep bits, the mode (bits 3 - 5) and the fan
+ * speed (bits 0 - 2); temperature uses bits 0 - 4, the rest is reserved;
+ * features holds the toggled functions. Temperature and fan speed are what
+ * the getters return, NOTEMP in FAN and NONE_SP in AUTO and DRY.
+ */
+#define PACKED_ACTIVE    0x80
+#define PACKED_SLEEP     0x40
+#define PACKED_MODE      0x38
+#define PACKED_FANSPEED  0x07
+#define PACKED_MODE_SHIFT 3
+#define PACKED_TEMP      0x1F
+#define PACKED_SWING     0x01
+#define PACKED_TURBO     0x02
+#define PACKED_CLEANAIR  0x04
+#define PACKED_LEDDISP   0x08
+
+// fields that changed since the last takeChanges(), as the getters report them
+#define CHANGED_ACTIVE   0x0001
+#define CHANGED_SLEEP    0x0002
+#define CHANGED_MODE     0x0004
+#define CHANGED_FANSPEED 0x0008
+#define CHANGED_TEMP     0x0010
+#define CHANGED_TIMERON  0x0020
+#define CHANGED_TIMEROFF 0x0040
+#define CHANGED_SWING    0x0080
+#define CHANGED_TURBO    0x0100
+#define CHANGED_CLEANAIR 0x0200
+#define CHANGED_LEDDISP  0x0400
+#define CHANGED_ALL      0x07FF
+
+struct PackedState
+{
+    uint8_t flags;
+    uint8_t temperature;
+    uint8_t timerOn;
+    uint8_t timerOff;
+    uint8_t features;
+};
+
+// one transmitted frame in the trace
+struct FrameTrace
+{
+    uint32_t at;                    // halMillis()
+    uint8_t frame[IR_FRAME_LEN];
+    uint8_t tag;                    // setCommandTag() when it was sent
+};
+
+// an entry as dumpTrace() writes it: at (low byte first), the frame, the tag
+#define IR_TRACE_ENTRY_BYTES (4 + IR_FRAME_LEN + 1)
+
+// the whole trace fits dumpTrace()'s count and one XBee packet (100 bytes) behind a report type
+#define IR_TRACE_MAX_BYTES 99
+
+static_assert(IR_TRACE_LEN * IR_TRACE_ENTRY_BYTES <= IR_TRACE_MAX_BYTES,
+              "IR_TRACE_LEN frames do not fit in one trace report");
+
+class ToyotomiGroup;
 
 class Toyotomi
 {
     public:
+        typedef ToyotomiProtocol Protocol;
+        
+        class Batch;
+        
+
         Toyotomi(uint8_t _temp = DEFAULT_TEMP, Mode _mode = AUTO,
                  FanSpeed _fanSpeed = DEFAULT_SP, TimerTime _timerOn = DEFAULT_TIMER,
                  TimerTime _timerOff = DEFAULT_TIMER, bool = DEFAULT_POWER);
-        ~Toyotomi(void);
+        virtual ~Toyotomi(void);
         uint8_t buttonTempUp(uint8_t _times = 1);
         uint8_t buttonTempDown(uint8_t _times = 1);
         void buttonOn(void);
@@ -127,6 +217,12 @@ class Toyotomi
         void powerOff(void);
         //bool setSleep(bool _sleep = DEFAULT_SLEEP);
         void setState(uint8_t _temperature, Mode _mode, FanSpeed _fanSpeed);
+        bool setSwing(bool _swing);
+        bool setTurbo(bool _turbo);
+        bool setCleanAir(bool _cleanAir);
+        bool setLedDisplay(bool _ledDisplay);
+        void beginUpdate(void);
+        bool commit(void);
 
         bool isPoweredOn(void);
         uint8_t getTemperature(void);
@@ -135,8 +231,40 @@ class Toyotomi
         TimerTime getTimerOn(void);
         TimerTime getTimerOff(void);
         bool isSleepOn(void);
+        bool isSwingOn(void);
+        bool isTurboOn(void);
+        bool isCleanAirOn(void);
+        bool isLedDisplayOn(void);
+        PackedState getPackedState(void);
+        uint16_t takeChanges(void);
+        
+        bool isTransmitting(void);
+        void onTransmitDone(TransmitCallback);
+        uint16_t getUartOverruns(void);
+        uint8_t setIRLEDPin(uint8_t _IRLEDPin = DEFAULT_LED_PIN);
+        uint8_t getIRLEDPin(void);
+        void forceResend(void);
+        void setResendInterval(uint32_t _ms = 0);
+        uint16_t getSkippedFrames(void);
+        uint16_t getFramesSent(void);
+        uint32_t getLastFrameStart(void);
+        uint32_t getLastFrameCycles(void);
+        
+        static void idle(void);
+        static uint16_t takeAwakePermille(void);
+        static void setCommandTag(uint8_t _tag);
+        static uint8_t dumpTrace(uint8_t _out[]);
+        
+    protected:
+        Toyotomi(uint8_t _IRLEDPin, uint8_t _temp, Mode _mode, FanSpeed _fanSpeed,
+                 TimerTime _timerOn, TimerTime _timerOff, bool _active);
+        virtual void _carrierPeriods(uint8_t, uint8_t);
+        virtual void _transmit(const uint8_t [], const uint8_t);
         
     private:
+        friend class ToyotomiGroup;
+        template <class> friend struct IREngine;
+        
         uint8_t _setTemperature(uint8_t _temperature = DEFAULT_TEMP);
         Mode _setMode(Mode _mode = DEFAULT_MODE);
         FanSpeed _setFanSpeed(FanSpeed _fanSpeed = DEFAULT_FANSPEED);
@@ -144,6 +272,11 @@ class Toyotomi
         TimerTime _setTimerOff(TimerTime _time = DEFAULT_TIMER);
         bool _setActive(const bool = false);
         bool _setSleep(const bool = DEFAULT_SLEEP);
+        bool _setFeature(bool &, const bool, const uint16_t);
+        void _sendToggle(const uint32_t);
+        bool _commitState(void);
+        bool _commitToggles(void);
+        bool _commitToggle(bool &, const uint8_t, const uint32_t, const uint16_t, const bool);
         
         uint8_t _getTemperature(void);
         Mode _getMode(void);
@@ -154,21 +287,27 @@ class Toyotomi
         bool _timerOnIsOn(void);
         bool _timerOffIsOn(void);
         
-        uint32_t _tempMap(const uint8_t = MIN_TEMP - 1);
-        uint32_t _modeMap(const Mode = AUTO);
-        uint32_t _timerOffMap(const TimerTime = HOUR000);
-        uint32_t _timerOnMap(const TimerTime = HOUR000);
-        uint32_t _fanSpeedMap(const FanSpeed = DEFAULT_FANSPEED);
-        void _createByteArray(const uint32_t, const uint32_t, uint8_t [], const uint8_t = DEFAULT_DATA_LEN);
+        ToyotomiState _codecState(void);
+        uint32_t _stateWord(void);
+        uint32_t _invertedWord(const uint32_t);
+        void _sendState(const bool = true);
+        bool _sendFrame(const uint32_t, const uint32_t);
         uint8_t _setIRLEDPin(uint8_t = DEFAULT_LED_PIN);
         uint8_t _getIRLEDPin(void);
-        void _pulsesIR(long int, uint8_t);
-        void _sendHIGH(uint8_t = DEFAULT_LED_PIN);
-        void _sendLOW(uint8_t = DEFAULT_LED_PIN);
+        void _carrierBegin(void);
+        void _criticalEnd(void);
+        static void _traceFrame(const uint8_t []);
         void sendData(const uint8_t [], uint8_t = DEFAULT_DATA_LEN, const bool = true);
-        void sendDataNoHeaders(const uint8_t [], uint8_t = DEFAULT_DATA_LEN);
+        void _sendNow(const uint8_t [], const bool);
+        void sendDataNoHeaders(const uint8_t [], uint8_t = DEFAULT_DATA_LEN, uint8_t = 0);
         
-        uint8_t dataInBuf[DEFAULT_DATA_LEN];
+        static HAL_THREAD_LOCAL uint8_t dataInBuf[IR_FRAME_LEN]; // DEFAULT_DATA_LEN bits, LSB first
+        uint8_t _batchDepth;
+        bool _batchWasOn;
+        uint32_t _batchNor;
+        uint32_t _batchInv;
+        uint8_t _batchFeatures;             // PACKED_* functions at beginUpdate()
+        uint8_t _batchSteps;                // air direction steps held back
         uint8_t _temperature;
         Mode _mode;
         TimerTime _timerOff;
@@ -176,7 +315,51 @@ class Toyotomi
         FanSpeed _fanSpeed;
         bool _active;
         bool _sleepState;
+        bool _swing;
+        bool _turbo;
+        bool _cleanAir;
+        bool _ledDisplay;
         uint8_t _IRLEDPin;
+        ToyotomiGroup *_group;
+        uint16_t _uartOverruns;
+        uint16_t _changes;
+        uint8_t _lastFrame[IR_FRAME_LEN];   // last state or power off frame sent
+        bool _lastFrameValid;
+        uint32_t _lastFrameAt;              // halMillis() when it was sent
+        uint32_t _resendInterval;
+        uint16_t _skippedFrames;
+        uint16_t _framesSent;
+        uint32_t _frameStart;               // halCycles() when the last frame was handed over
+        uint32_t _frameCycles;              // until the blocking engine returned
+        static HAL_THREAD_LOCAL uint32_t _sleptUs;      // asleep in idle() since takeAwakePermille()
+        static HAL_THREAD_LOCAL uint32_t _awakeSince;   // halMillis() of the last takeAwakePermille()
+        static HAL_THREAD_LOCAL uint8_t _commandTag;
+#if IR_TRACE_LEN
+        static HAL_THREAD_LOCAL FrameTrace _trace[IR_TRACE_LEN];
+        static HAL_THREAD_LOCAL uint8_t _traceHead;     // next entry to write
+        static HAL_THREAD_LOCAL uint8_t _traceCount;
+#endif
+};
+
+/*
+ * Groups setters into a single IR frame for as long as it is in scope:
+ * 
+ *     {
+ *         Toyotomi::Batch batch(toyo);
+ *         toyo.setMode(COOL);
+ *         toyo.setTemperature(24);
+ *         toyo.setSwing(true);
+ *     }   // one state frame sent here, or none if nothing changed,
+ *         // then the toggle codes of the functions that changed
+ */
+class Toyotomi::Batch
+{
+    public:
+        Batch(Toyotomi &_unit);
+        ~Batch(void);
+        
+    private:
+        Toyotomi &_unit;
 };
 
 #endif
@@ -0,0 +1,219 @@
+/*
+ * ToyotomiCodec.h - Toyotomi HVAC Remote Control Library
+ *
+ * The state frame logic on its own: a state to its command and check words,
+ * and a received frame back to the state. Header only and free of any
+ * hardware access, so it builds unchanged on the Arduino and natively (a
+ * gateway decoding captured frames, extras/codec).
+ *
+ * The protocol is not one to one. DRY and FAN share a mode code, NOTEMP
+ * goes out as MIN_TEMP, and an off timer of HOUR000 uses the HOUR080 code,
+ * so decode() returns DRY, MIN_TEMP and HOUR000 for those. It picks
+ * HOUR080 only where HOUR000 could not have produced the frame.
+ *
+ * Release into the public domain.
+*/
+
+#ifndef TOYOTOMI_CODEC_H
+#define TOYOTOMI_CODEC_H
+
+#include "ToyotomiProtocol.h"
+
+struct ToyotomiState
+{
+    uint8_t temperature;
+    Mode mode;
+    FanSpeed fanSpeed;
+    TimerTime timerOn;
+    TimerTime timerOff;
+};
+
+/*
+ * What a frame decodes to. STATE_FRAME has the plain check word and carries
+ * no on timer (powerOn() or both timers off), TIMER_FRAME has the timers in
+ * its check word. The others are the fixed command words.
+ */
+enum FrameType { INVALID_FRAME, STATE_FRAME, TIMER_FRAME, POWER_OFF_FRAME, AIR_DIRECTION_FRAME,
+                 SWING_FRAME, CLEAN_AIR_FRAME, LED_DISPLAY_FRAME, TURBO_FRAME };
+
+// first entry from _first on whose _mask bits are _bits, -1 if none
+constexpr int8_t _codecIndex(const uint32_t _map[], const uint8_t _len, const uint32_t _mask,
+                             const uint32_t _bits, const uint8_t _first)
+{
+    return _first == _len ? -1 :
+           (_map[_first] & _mask) == _bits ? _first : _codecIndex(_map, _len, _mask, _bits, _first + 1);
+}
+
+// the six off timer bits packed into 0 .. 63 and back
+constexpr uint8_t _timerOffKey(const uint32_t _bits)
+{
+    return ((_bits >> 6) & 0x03) | ((_bits >> 9) & 0x3C);
+}
+
+constexpr uint32_t _timerOffBits(const uint8_t _key)
+{
+    return ((uint32_t)(_key & 0x03) << 6) | ((uint32_t)(_key & 0x3C) << 9);
+}
+
+/*
+ * Inverse maps, indexed by the field bits shifted down, giving the map
+ * index or -1. HOUR000 of timerOnMap is never sent (NOTIMONVAL is), so that
+ * search starts at HOUR005. Evaluated entirely by the compiler.
+ */
+constexpr int8_t _tempIndex(const uint8_t k)     { return _codecIndex(tempMap, 15, TEMP_MASK, k, 0); }
+constexpr int8_t _modeIndex(const uint8_t k)     { return _codecIndex(modeMap, FAN + 1, MODE_MASK, (uint32_t)k << 4, 0); }
+constexpr int8_t _fanSpeedIndex(const uint8_t k) { return _codecIndex(fanSpeedMap, HIGH_SP + 1, FANSPEED_MASK, (uint32_t)k << 8, 0); }
+constexpr int8_t _timerOnIndex(const uint8_t k)  { return _codecIndex(timerOnMap, HOUR240 + 1, TIMONTIM_MASK, (uint32_t)k << 1, HOUR005); }
+constexpr int8_t _timerOffIndex(const uint8_t k) { return _codecIndex(timerOffMap, HOUR240 + 1, TIMOFFTIM_MASK, _timerOffBits(k), HOUR000); }
+
+#define CODEC_INDEX_4(f, k)  f(k), f(k + 1), f(k + 2), f(k + 3)
+#define CODEC_INDEX_16(f, k) CODEC_INDEX_4(f, k), CODEC_INDEX_4(f, k + 4), CODEC_INDEX_4(f, k + 8), \
+                             CODEC_INDEX_4(f, k + 12)
+#define CODEC_INDEX_64(f, k) CODEC_INDEX_16(f, k), CODEC_INDEX_16(f, k + 16), CODEC_INDEX_16(f, k + 32), \
+                             CODEC_INDEX_16(f, k + 48)
+
+constexpr int8_t tempIndex[] PROGMEM     = { CODEC_INDEX_16(_tempIndex, 0) };
+constexpr int8_t modeIndex[] PROGMEM     = { CODEC_INDEX_4(_modeIndex, 0) };
+constexpr int8_t fanSpeedIndex[] PROGMEM = { CODEC_INDEX_4(_fanSpeedIndex, 0), CODEC_INDEX_4(_fanSpeedIndex, 4) };
+constexpr int8_t timerOnIndex[] PROGMEM  = { CODEC_INDEX_64(_timerOnIndex, 0) };
+constexpr int8_t timerOffIndex[] PROGMEM = { CODEC_INDEX_64(_timerOffIndex, 0) };
+
+struct ToyotomiCodec
+{
+    // field bits of each setting, out of range values as the library sends them
+    static inline uint32_t tempBits(const uint8_t _temperature)
+    {
+        // NOTEMP goes out as MIN_TEMP too
+        if (_temperature >= MIN_TEMP && _temperature <= MAX_TEMP)
+            return _read(&tempMap[_temperature - MIN_TEMP]);
+        return _read(&tempMap[0]);
+    }
+
+    static inline uint32_t modeBits(const Mode _mode)
+    {
+        return _read(&modeMap[_mode >= AUTO && _mode <= FAN ? _mode : AUTO]);
+    }
+
+    static inline uint32_t fanSpeedBits(const FanSpeed _fanSpeed)
+    {
+        return _read(&fanSpeedMap[_fanSpeed >= NONE_SP && _fanSpeed <= HIGH_SP ? _fanSpeed : DEFAULT_SP]);
+    }
+
+    static inline uint32_t timerOnBits(const TimerTime _timerOn)
+    {
+        return _read(&timerOnMap[_timerOn >= HOUR000 && _timerOn <= HOUR240 ? _timerOn : HOUR000]);
+    }
+
+    static inline uint32_t timerOffBits(const TimerTime _timerOff)
+    {
+        return _read(&timerOffMap[_timerOff >= HOUR000 && _timerOff <= HOUR240 ? _timerOff : HOUR000]);
+    }
+
+    static inline uint32_t stateWord(const ToyotomiState &_state)
+    {
+        return (TEMP_MASK & tempBits(_state.temperature)) |
+               (MODE_MASK & modeBits(_state.mode)) |
+               (FANSPEED_MASK & fanSpeedBits(_state.fanSpeed)) |
+               (TIMOFFTIM_MASK & timerOffBits(_state.timerOff)) |
+               (DEFAULT_MASK & DEFAULT_HEAD);
+    }
+
+    // check word of a state frame, the timers go in it once one is set
+    static inline uint32_t checkWord(const ToyotomiState &_state, const uint32_t _word)
+    {
+        if (_state.timerOn == HOUR000 && _state.timerOff == HOUR000)
+            return ToyotomiProtocol::check(_word);
+
+        return ToyotomiProtocol::timerCheck(_word, _state.timerOn == HOUR000 ?
+                                            NOTIMONVAL : timerOnBits(_state.timerOn));
+    }
+
+    // _withTimers false sends the plain check word, as powerOn() does
+    static inline void encode(const ToyotomiState &_state, uint8_t _frame[], const bool _withTimers = true)
+    {
+        uint32_t _word = stateWord(_state);
+
+        ToyotomiProtocol::encode(_word, _withTimers ? checkWord(_state, _word) : ToyotomiProtocol::check(_word),
+                                 _frame);
+    }
+
+    /*
+     * Validates the check bytes and maps the fields back to a state. The
+     * state is only written for STATE_FRAME and TIMER_FRAME.
+     */
+    static inline FrameType decode(const uint8_t _frame[], ToyotomiState &_state)
+    {
+        uint32_t _word;
+        uint8_t _check = _frame[5];
+        int8_t _temp, _mode, _fanSpeed, _timerOn, _timerOff;
+        bool _timers;
+
+        if ((uint8_t)~_frame[0] != _frame[1] || (uint8_t)~_frame[2] != _frame[3])
+            return INVALID_FRAME;
+
+        _word = ((uint32_t)_frame[0] << 16) | ((uint32_t)_frame[2] << 8) | _frame[4];
+        _timers = (uint8_t)~_frame[4] != _check;
+
+        if (!_timers)
+        {
+            switch (_word)
+            {
+                case POWER_OFF:     return POWER_OFF_FRAME;
+                case AIR_DIRECTION: return AIR_DIRECTION_FRAME;
+                case SWING:         return SWING_FRAME;
+                case CLEAN_AIR:     return CLEAN_AIR_FRAME;
+                case LED_DISPLAY:   return LED_DISPLAY_FRAME;
+                case TURBO:         return TURBO_FRAME;
+            }
+        }
+        // a timer check byte repeats TIMENCOM and sets ONTIMER, the plain one flips TIMENCOM
+        else if ((_check & ONTIMER_MASK) != ONTIMERVAL || (_check & TIMENCOM_MASK) != (_word & TIMENCOM_MASK))
+            return INVALID_FRAME;
+
+        if ((_word & DEFAULT_MASK) != (DEFAULT_MASK & DEFAULT_HEAD))
+            return INVALID_FRAME;
+
+        _temp = _readIndex(&tempIndex[_word & TEMP_MASK]);
+        _mode = _readIndex(&modeIndex[(_word & MODE_MASK) >> 4]);
+        _fanSpeed = _readIndex(&fanSpeedIndex[(_word & FANSPEED_MASK) >> 8]);
+        _timerOff = _readIndex(&timerOffIndex[_timerOffKey(_word & TIMOFFTIM_MASK)]);
+        _timerOn = HOUR000;
+        if (_timers && (_check & TIMONTIM_MASK) != (NOTIMONVAL & TIMONTIM_MASK))
+            _timerOn = _readIndex(&timerOnIndex[(_check & TIMONTIM_MASK & ~ONTIMER_MASK) >> 1]);
+
+        if (_temp < 0 || _mode < 0 || _fanSpeed < 0 || _timerOn < 0 || _timerOff < 0)
+            return INVALID_FRAME;
+
+        // both timers off is sent with the plain check word, so this is HOUR080
+        if (_timers && _timerOn == HOUR000 && _timerOff == HOUR000)
+            _timerOff = HOUR080;
+
+        _state.temperature = _temp == 14 ? NOTEMP : MIN_TEMP + _temp;
+        _state.mode = (Mode)_mode;
+        _state.fanSpeed = (FanSpeed)_fanSpeed;
+        _state.timerOn = (TimerTime)_timerOn;
+        _state.timerOff = (TimerTime)_timerOff;
+
+        return _timers ? TIMER_FRAME : STATE_FRAME;
+    }
+
+    static inline uint32_t _read(const uint32_t *_entry)
+    {
+#ifdef ARDUINO
+        return pgm_read_word(_entry);
+#else
+        return *_entry;
+#endif
+    }
+
+    static inline int8_t _readIndex(const int8_t *_entry)
+    {
+#ifdef ARDUINO
+        return pgm_read_byte(_entry);
+#else
+        return *_entry;
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * ToyotomiCommands.h - Toyotomi HVAC Remote Control Library
+ *
+ * The radio commands of Toyotomi.ino: dispatch to a Toyotomi, the
+ * coalescing window for bursts of set-commands and the state report. The
+ * radio, the scheduler and the statistics stay with the Host, so the
+ * sketch and every node of the fleet simulator run this same code:
+ *
+ *     struct SketchHost { ... };
+ *     SketchHost host;
+ *     ToyotomiCommands<SketchHost> commands(toyo, host, 300);
+ *
+ *     commands.handle(packet);       // 1, command, arguments
+ *
+ * The Host provides
+ *
+ *     void scheduleCommit(uint16_t ms)    call closeWindow() in ms
+ *     void commandStarting(uint8_t)       every command, before it runs
+ *     void commandDone(bool windowed)     after commands 1 - 19; windowed
+ *                                         if the open window holds it
+ *     void windowClosing(void)            before the window is sent
+ *     void windowClosed(void)             after it
+ *     void sendStats(uint8_t)             command 20
+ *     void sendTrace(void)                command 21
+ *     void sendPackedState(uint16_t changes, const PackedState &)
+ *     void sendValue(const char *name, int value)
+ *
+ * Release into the public domain.
+*/
+
+#ifndef TOYOTOMI_COMMANDS_H
+#define TOYOTOMI_COMMANDS_H
+
+#include "Toyotomi.h"
+
+#define COMMAND_LEN 5               // 1, command, up to three arguments
+
+template <class Host>
+class ToyotomiCommands
+{
+    public:
+        // _windowMs 0 sends a frame for every command; _text sends one
+        // sendValue() per changed field instead of the PackedState
+        ToyotomiCommands(Toyotomi &_toyo, Host &_owner, uint16_t _windowMs, bool _text = false)
+            : _unit(_toyo), _host(_owner), _window(_windowMs), _textReport(_text), _coalescing(false)
+        {
+        }
+        
+        void handle(const uint8_t _packet[]);
+        void openWindow(void);
+        void closeWindow(void);
+        bool isCoalescing(void) { return this->_coalescing; }
+        void sendState(void);
+    
+    private:
+        Toyotomi &_unit;
+        Host &_host;
+        const uint16_t _window;
+        const bool _textReport;
+        bool _coalescing;
+};
+
+template <class Host>
+void ToyotomiCommands<Host>::handle(const uint8_t _packet[])
+{
+    uint8_t _command = _packet[1];
+    
+    // toggles and resends go out at once, so the unit has to get the window's state first
+    if (_command == 8 || (_command >= 10 && _command <= 13) || (_command >= 15 && _command <= 19))
+        this->closeWindow();
+    
+    Toyotomi::setCommandTag(_command);
+    this->_host.commandStarting(_command);
+    if (_command >= 1 && _command <= 5)
+        this->openWindow();
+    
+    switch (_command)
+    {
+        case 1: // temperature
+            this->_unit.setTemperature(_packet[2]);
+            break;
+        case 2: // mode
+            this->_unit.setMode((Mode)_packet[2]);
+            break;
+        case 3: // fan speed
+            this->_unit.setFanSpeed((FanSpeed)_packet[2]);
+            break;
+        case 4: // timer on
+            this->_unit.setTimerOn((TimerTime)_packet[2]);
+            break;
+        case 5: // timer off
+            this->_unit.setTimerOff((TimerTime)_packet[2]);
+            break;
+        case 6: // power on
+            this->_unit.powerOn();
+            break;
+        case 7: // power off, sent at once with or without an open window
+            this->_unit.powerOff();
+            this->closeWindow();
+            break;
+        case 8: // swing
+            this->_unit.buttonSwing();
+            break;
+        /*case 9: // sleep
+            this->_unit.setSleep((bool)_packet[2]);
+            break;*/
+        case 10: // air direction
+            this->_unit.buttonAirDirection();
+            break;
+        case 11: // clean air
+            this->_unit.buttonCleanAir();
+            break;
+        case 12: // LED display
+            this->_unit.buttonLedDisplay();
+            break;
+        case 13: // turbo
+            this->_unit.buttonTurbo();
+            break;
+        case 14: // set values
+            this->_unit.setState(_packet[2], (Mode)_packet[3], (FanSpeed)_packet[4]);
+            break;
+        case 15: // resend
+            this->_unit.forceResend();
+            break;
+        case 16: // set swing
+            this->_unit.setSwing(_packet[2]);
+            break;
+        case 17: // set clean air
+            this->_unit.setCleanAir(_packet[2]);
+            break;
+        case 18: // set LED display
+            this->_unit.setLedDisplay(_packet[2]);
+            break;
+        case 19: // set turbo
+            this->_unit.setTurbo(_packet[2]);
+            break;
+        case 20: // stats of command _packet[2], 0 for all
+            this->_host.sendStats(_packet[2]);
+            return;
+        case 21: // frame trace
+            this->_host.sendTrace();
+            return;
+        default:
+            return;
+    }
+    
+    this->_host.commandDone(this->_coalescing && _command >= 1 && _command <= 5);
+}
+
+/*
+ * Set-commands only update the stored state while the window is open. It
+ * is not extended by later commands, so a continuous burst still sends a
+ * frame every _window ms.
+ */
+template <class Host>
+void ToyotomiCommands<Host>::openWindow()
+{
+    if (!this->_window || this->_coalescing)
+        return;
+    
+    this->_unit.beginUpdate();
+    this->_coalescing = true;
+    this->_host.scheduleCommit(this->_window);
+}
+
+template <class Host>
+void ToyotomiCommands<Host>::closeWindow()
+{
+    if (!this->_coalescing)
+        return;
+    
+    this->_coalescing = false;
+    this->_host.windowClosing();
+    this->_unit.commit();
+    this->_host.windowClosed();
+}
+
+// reports the fields changed since the last report, nothing if none did
+template <class Host>
+void ToyotomiCommands<Host>::sendState()
+{
+    uint16_t _changes = this->_unit.takeChanges();
+    
+    if (!_changes)
+        return;
+    
+    if (!this->_textReport)
+    {
+        this->_host.sendPackedState(_changes, this->_unit.getPackedState());
+        return;
+    }
+    
+    if (_changes & CHANGED_ACTIVE)
+        this->_host.sendValue("ac_active", this->_unit.isPoweredOn());
+    if (_changes & CHANGED_TEMP)
+        this->_host.sendValue("ac_temp", this->_unit.getTemperature());
+    if (_changes & CHANGED_MODE)
+        this->_host.sendValue("ac_mode", this->_unit.getMode());
+    if (_changes & CHANGED_FANSPEED)
+        this->_host.sendValue("ac_fanspeed", this->_unit.getFanSpeed());
+    if (_changes & CHANGED_TIMERON)
+        this->_host.sendValue("ac_timeron", this->_unit.getTimerOn());
+    if (_changes & CHANGED_TIMEROFF)
+        this->_host.sendValue("ac_timeroff", this->_unit.getTimerOff());
+    if (_changes & CHANGED_SLEEP)
+        this->_host.sendValue("ac_sleep", this->_unit.isSleepOn());
+    if (_changes & CHANGED_SWING)
+        this->_host.sendValue("ac_swing", this->_unit.isSwingOn());
+    if (_changes & CHANGED_TURBO)
+        this->_host.sendValue("ac_turbo", this->_unit.isTurboOn());
+    if (_changes & CHANGED_CLEANAIR)
+        this->_host.sendValue("ac_cleanair", this->_unit.isCleanAirOn());
+    if (_changes & CHANGED_LEDDISP)
+        this->_host.sendValue("ac_leddisplay", this->_unit.isLedDisplayOn());
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ * ToyotomiEngine.h - Toyotomi HVAC Remote Control Library
+ * 
+ * Blocking transmit engine, instantiated per protocol traits class (see
+ * ToyotomiProtocol.h), so the frame format costs no runtime dispatch. The
+ * Output it plays through provides the carrier: _carrierPeriods(), the
+ * LED pin and _criticalEnd(), as Toyotomi does.
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef TOYOTOMI_ENGINE_H
+#define TOYOTOMI_ENGINE_H
+
+#include "ToyotomiHal.h"
+
+template <class Protocol>
+struct IREngine
+{
+    static_assert(Protocol::carrierHz == IR_CLOCK_RATE, "the carrier is generated at IR_CLOCK_RATE");
+    
+    // one protocol unit in CPU cycles and in Timer1 ticks
+    static constexpr uint32_t unitCycles = (F_CPU / 1000L) * Protocol::unitUs / 1000L;
+    static constexpr uint32_t unitTicks = (F_CPU / IR_TIMER1_PRESCALE / 1000L) * Protocol::unitUs / 1000L;
+    
+    template <class Output>
+    static void mark(Output &_out, uint8_t _units)
+    {
+#ifdef IR_TIMER2_CARRIER
+        // the carrier runs in hardware, an interrupt only stretches the mark a bit
+        halCarrierOn();
+        for (; _units; _units--)
+            halDelayCycles<unitCycles>();
+        halCarrierOff();
+#else
+        /*
+         * Interrupts are held off for one protocol unit at a time, which
+         * keeps the carrier clean and is still shorter than the three
+         * characters the serial port can buffer (780 us at 38400 baud).
+         * Spaces run with interrupts enabled.
+         */
+        for (; _units; _units--)
+        {
+            halIrqOff();
+            _out._carrierPeriods(Protocol::unitPeriods, _out._getIRLEDPin());
+            _out._criticalEnd();
+        }
+#endif
+    }
+    
+    static void space(uint8_t _units)
+    {
+        for (; _units; _units--)
+            halDelayCycles<unitCycles>();
+    }
+    
+    template <class Output>
+    static void symbol(Output &_out, const uint8_t _data[], const uint8_t _symbol)
+    {
+        mark(_out, Protocol::mark(_symbol));
+        space(Protocol::space(_data, _symbol));
+    }
+    
+    template <class Output>
+    static void send(Output &_out, const uint8_t _data[], uint8_t _passes)
+    {
+        for (; _passes; _passes--)
+            for (uint8_t _symbol = 0; _symbol < Protocol::symbols; _symbol++)
+                symbol(_out, _data, _symbol);
+    }
+};
+
+template <class Protocol> constexpr uint32_t IREngine<Protocol>::unitCycles;
+template <class Protocol> constexpr uint32_t IREngine<Protocol>::unitTicks;
+
+#endif
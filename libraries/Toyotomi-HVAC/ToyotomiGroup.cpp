@@ -0,0 +1,196 @@
+/*
+ * ToyotomiGroup.cpp - Toyotomi HVAC Remote Control Library
+ * 
+ * Release into the public domain.
+*/
+
+
+#include <ToyotomiGroup.h>
+
+#ifndef IR_TIMER2_CARRIER
+
+// position of one member in its frame
+struct IRGroupCursor
+{
+    uint8_t symbol;
+    uint8_t passes;     // 0 once the frame is done
+    uint8_t left;       // units left in the current mark or space
+    bool inMark;
+};
+
+static void _advance(IRGroupCursor &_cursor, const uint8_t _data[])
+{
+    if (--_cursor.left)
+        return;
+    
+    if (_cursor.inMark)
+    {
+        _cursor.inMark = false;
+        _cursor.left = ToyotomiProtocol::space(_data, _cursor.symbol);
+        return;
+    }
+    
+    if (++_cursor.symbol == ToyotomiProtocol::symbols)
+    {
+        _cursor.symbol = 0;
+        if (!--_cursor.passes)
+            return;
+    }
+    _cursor.inMark = true;
+    _cursor.left = ToyotomiProtocol::mark(_cursor.symbol);
+}
+
+#endif
+
+
+ToyotomiGroup::ToyotomiGroup()
+{
+    this->_count = 0;
+    this->_capturing = false;
+    this->_uartOverruns = 0;
+}
+
+
+// false if the group is full or another member already uses the LED pin
+bool ToyotomiGroup::add(Toyotomi &_unit)
+{
+    if (this->_count == IR_GROUP_MAX || _unit._group)
+        return false;
+#ifndef IR_TIMER2_CARRIER
+    for (uint8_t i = 0; i < this->_count; i++)
+        if (this->_units[i]->_getIRLEDPin() == _unit._getIRLEDPin())
+            return false;
+#endif
+    
+    this->_units[this->_count] = &_unit;
+    this->_passes[this->_count] = 0;
+    this->_count++;
+    _unit._group = this;
+    
+    return true;
+}
+
+
+void ToyotomiGroup::begin()
+{
+    this->_capturing = true;
+}
+
+
+// plays the frames held since begin(), returns how many there were
+uint8_t ToyotomiGroup::send()
+{
+    this->_capturing = false;
+    
+    return this->_play();
+}
+
+
+uint16_t ToyotomiGroup::getUartOverruns()
+{
+    return this->_uartOverruns;
+}
+
+
+bool ToyotomiGroup::_capture(Toyotomi *_unit, const uint8_t _data[], const bool repeat)
+{
+    uint8_t i;
+    
+    if (!this->_capturing)
+        return false;
+    
+    for (i = 0; this->_units[i] != _unit; i++)
+        ;
+    if (this->_passes[i])
+        this->_play();  // a second frame for the same unit, keep them in order
+    
+    memcpy(this->_frames[i], _data, IR_FRAME_LEN);
+    this->_passes[i] = repeat ? 2 : 1;
+    
+    return true;
+}
+
+
+uint8_t ToyotomiGroup::_play()
+{
+    uint8_t _frames = 0;
+    
+#ifdef IR_TIMER2_CARRIER
+    // traced when they were captured
+    for (uint8_t i = 0; i < this->_count; i++)
+    {
+        if (!this->_passes[i])
+            continue;
+        this->_units[i]->_sendNow(this->_frames[i], this->_passes[i] == 2);
+        this->_passes[i] = 0;
+        _frames++;
+    }
+#else
+    IRGroupCursor _cursor[IR_GROUP_MAX];
+    uint8_t _masks[IR_GROUP_MAX];   // PORTB bit of each LED, setIRLEDPin() may have moved it
+    uint8_t _mask;
+    bool _busy;
+    
+    for (uint8_t i = 0; i < this->_count; i++)
+    {
+        _masks[i] = _BV(this->_units[i]->_getIRLEDPin() - 8);
+        _cursor[i].symbol = 0;
+        _cursor[i].passes = this->_passes[i];
+        _cursor[i].left = ToyotomiProtocol::mark(0);
+        _cursor[i].inMark = true;
+        if (this->_passes[i])
+            _frames++;
+        this->_passes[i] = 0;
+    }
+    
+    for (;;)
+    {
+        _mask = 0;
+        _busy = false;
+        for (uint8_t i = 0; i < this->_count; i++)
+        {
+            if (!_cursor[i].passes)
+                continue;
+            _busy = true;
+            if (_cursor[i].inMark)
+                _mask |= _masks[i];
+        }
+        if (!_busy)
+            break;
+        
+        if (_mask)
+            this->_carrierUnit(_mask);
+        else
+            halDelayCycles<IR_UNIT_CYCLES>();
+        
+        for (uint8_t i = 0; i < this->_count; i++)
+            if (_cursor[i].passes)
+                _advance(_cursor[i], this->_frames[i]);
+    }
+#endif
+    
+    return _frames;
+}
+
+
+// one protocol unit of carrier on every LED in _mask
+void ToyotomiGroup::_carrierUnit(const uint8_t _mask)
+{
+#ifndef IR_TIMER2_CARRIER
+    static_assert(IR_HALF_PERIOD_CYCLES > IR_MASK_WRITE_CYCLES + IR_LOOP_CYCLES,
+                  "F_CPU is too slow for a software carrier");
+    
+    halIrqOff();
+    for (uint8_t i = PULSE_CYCLES; i; i--)
+    {
+        halPortHigh(_mask);
+        halDelayCycles<IR_CARRIER_DELAY(IR_MASK_WRITE_CYCLES)>();
+        halPortLow(_mask);
+        halDelayCycles<IR_CARRIER_DELAY(IR_MASK_WRITE_CYCLES + IR_LOOP_CYCLES)>();
+        halLoopCycles<IR_LOOP_CYCLES>();
+    }
+    if (halUartOverrun())
+        this->_uartOverruns++;
+    halIrqOn();
+#endif
+}
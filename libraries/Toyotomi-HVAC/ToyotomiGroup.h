@@ -0,0 +1,56 @@
+/*
+ * ToyotomiGroup.h - Toyotomi HVAC Remote Control Library
+ * 
+ * Sends the frames of up to IR_GROUP_MAX units at the same time, each on
+ * its own IR LED pin of PORTB:
+ * 
+ *     ToyotomiGroup rooms;
+ *     
+ *     rooms.add(livingRoom);
+ *     rooms.add(bedroom);
+ *     
+ *     rooms.begin();
+ *     livingRoom.setTemperature(22);
+ *     bedroom.powerOff();
+ *     rooms.send();
+ * 
+ * Between begin() and send() the frames of the members are held back and
+ * send() plays them together, one protocol unit at a time with every LED
+ * whose frame is in a mark switched by the same port write. With the Timer2
+ * carrier there is only one LED pin, and the frames go out one by one.
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef TOYOTOMI_GROUP_H
+#define TOYOTOMI_GROUP_H
+
+#include "Toyotomi.h"
+
+#define IR_GROUP_MAX     4
+
+class ToyotomiGroup
+{
+    public:
+        ToyotomiGroup(void);
+        bool add(Toyotomi &);
+        void begin(void);
+        uint8_t send(void);
+        uint16_t getUartOverruns(void);
+        
+    private:
+        friend class Toyotomi;
+        
+        bool _capture(Toyotomi *, const uint8_t [], const bool);
+        uint8_t _play(void);
+        void _carrierUnit(const uint8_t);
+        
+        Toyotomi *_units[IR_GROUP_MAX];
+        uint8_t _frames[IR_GROUP_MAX][IR_FRAME_LEN];
+        uint8_t _passes[IR_GROUP_MAX];              // 0 while nothing is held
+        uint8_t _count;
+        bool _capturing;
+        uint16_t _uartOverruns;
+};
+
+#endif
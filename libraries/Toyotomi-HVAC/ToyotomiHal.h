@@ -0,0 +1,219 @@
+/*
+ * ToyotomiHal.h - Toyotomi HVAC Remote Control Library
+ *
+ * Hardware access used by the library. On the Arduino every function maps
+ * straight onto the core or the AVR registers and compiles away. On any
+ * other platform the functions are only declared here and a backend has to
+ * be linked in; extras/host/MockHal.cpp is the one used for native builds.
+ *
+ * Release into the public domain.
+*/
+
+#ifndef TOYOTOMI_HAL_H
+#define TOYOTOMI_HAL_H
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+
+#define HAL_THREAD_LOCAL
+
+static inline void halPinOutput(uint8_t _pin)
+{
+    pinMode(_pin, OUTPUT);
+}
+
+static inline void halPinWrite(uint8_t _pin, uint8_t _level)
+{
+    digitalWrite(_pin, _level);
+}
+
+static inline void halDelayUs(unsigned int _us)
+{
+    delayMicroseconds(_us);
+}
+
+static inline void halIrqOff(void)
+{
+    cli();
+}
+
+static inline void halIrqOn(void)
+{
+    sei();
+}
+
+// receive overrun flag of the serial port, cleared by reading UDR0
+static inline bool halUartOverrun(void)
+{
+#ifdef DOR0
+    return UCSR0A & _BV(DOR0);
+#else
+    return false;
+#endif
+}
+
+// IR LEDs on PORTB, bit i of the mask is pin 8 + i
+static inline void halPortHigh(uint8_t _mask)
+{
+    PORTB |= _mask;
+}
+
+static inline void halPortLow(uint8_t _mask)
+{
+    PORTB &= ~_mask;
+}
+
+// busy-waits exactly Cycles CPU cycles
+template <uint32_t Cycles>
+static inline void halDelayCycles(void)
+{
+    __builtin_avr_delay_cycles(Cycles);
+}
+
+// the Cycles a carrier loop spends on its counter and branch, taken by the code itself
+template <uint32_t Cycles>
+static inline void halLoopCycles(void)
+{
+}
+
+static inline uint32_t halMillis(void)
+{
+    return millis();
+}
+
+static inline uint32_t halMicros(void)
+{
+    return micros();
+}
+
+// CPU cycles, to the 64 cycle resolution of Timer0; wraps, use differences
+static inline uint32_t halCycles(void)
+{
+    return micros() * (F_CPU / 1000000L);
+}
+
+// IDLE keeps the serial port and the timers running, any of their interrupts wakes the CPU
+static inline void halSleep(void)
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sleep_cpu();
+    sleep_disable();
+}
+
+static inline uint16_t halReadWord(const void *_addr)
+{
+    return pgm_read_word(_addr);
+}
+
+// Timer2 in CTC mode, OC2A disconnected until halCarrierOn()
+static inline void halCarrierBegin(uint8_t _clockSelect, uint8_t _top)
+{
+    TCCR2A = _BV(WGM21);
+    TCCR2B = _clockSelect;
+    OCR2A = _top;
+    TCNT2 = 0;
+}
+
+// toggle OC2A on every compare match
+static inline void halCarrierOn(void)
+{
+    TCCR2A |= _BV(COM2A0);
+}
+
+// OC2A falls back to the port value
+static inline void halCarrierOff(void)
+{
+    TCCR2A &= ~_BV(COM2A0);
+}
+
+/*
+ * IR LED on a pin known at compile time. Only PORTB (pins 8 - 13) is used
+ * for the LED, so register and bit are constants and every call compiles
+ * to a single sbi/cbi.
+ */
+template <uint8_t Pin>
+struct HalPortPin
+{
+    static inline void high(void)
+    {
+        PORTB |= _BV(Pin - 8);
+    }
+    
+    static inline void low(void)
+    {
+        PORTB &= ~_BV(Pin - 8);
+    }
+};
+
+#else
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#ifndef F_CPU
+#define F_CPU 8000000L
+#endif
+
+#define PROGMEM
+#define HIGH 0x1
+#define LOW  0x0
+
+// the library's statics, so boards simulated on several threads keep theirs apart
+#define HAL_THREAD_LOCAL thread_local
+
+void halPinOutput(uint8_t);
+void halPinWrite(uint8_t, uint8_t);
+void halDelayUs(unsigned int);
+void halSpinCycles(uint32_t);
+void halIrqOff(void);
+void halIrqOn(void);
+void halSleep(void);
+uint32_t halMillis(void);
+uint32_t halMicros(void);
+uint32_t halCycles(void);
+uint16_t halReadWord(const void *);
+void halCarrierBegin(uint8_t, uint8_t);
+void halCarrierOn(void);
+void halCarrierOff(void);
+bool halUartOverrun(void);
+void halPortHigh(uint8_t);
+void halPortLow(uint8_t);
+void halPortPinWrite(uint8_t, uint8_t);
+
+template <uint32_t Cycles>
+static inline void halDelayCycles(void)
+{
+    halSpinCycles(Cycles);
+}
+
+// instructions take no time here, so the loop overhead is spent explicitly
+template <uint32_t Cycles>
+static inline void halLoopCycles(void)
+{
+    halSpinCycles(Cycles);
+}
+
+template <uint8_t Pin>
+struct HalPortPin
+{
+    static inline void high(void)
+    {
+        halPortPinWrite(Pin, HIGH);
+    }
+    
+    static inline void low(void)
+    {
+        halPortPinWrite(Pin, LOW);
+    }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * ToyotomiPin.h - Toyotomi HVAC Remote Control Library
+ * 
+ * Toyotomi with the IR LED pin fixed at compile time:
+ * 
+ *     ToyotomiPin<9> toyo;
+ * 
+ * The software carrier then toggles the pin with single sbi/cbi
+ * instructions instead of digitalWrite, which leaves almost the whole half
+ * period to the cycle-counted delay and also works on clocks too slow for
+ * digitalWrite. With IR_TIMER2_CARRIER the carrier comes from Timer2 on
+ * pin 11 as usual.
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef TOYOTOMI_PIN_H
+#define TOYOTOMI_PIN_H
+
+#include "Toyotomi.h"
+
+template <uint8_t Pin>
+class ToyotomiPin : public Toyotomi
+{
+    static_assert(Pin >= 8 && Pin <= 13, "the IR LED has to be on pins 8 - 13 (PORTB)");
+    
+    public:
+        ToyotomiPin(uint8_t _temp = DEFAULT_TEMP, Mode _mode = AUTO,
+                    FanSpeed _fanSpeed = DEFAULT_SP, TimerTime _timerOn = DEFAULT_TIMER,
+                    TimerTime _timerOff = DEFAULT_TIMER, bool _active = DEFAULT_POWER)
+            : Toyotomi(Pin, _temp, _mode, _fanSpeed, _timerOn, _timerOff, _active)
+        {
+        }
+        
+#ifndef IR_TIMER2_CARRIER
+    protected:
+        void _carrierPeriods(uint8_t periods, uint8_t)
+        {
+            static_assert(IR_HALF_PERIOD_CYCLES > IR_PORT_WRITE_CYCLES + IR_LOOP_CYCLES,
+                          "F_CPU is too slow for a software carrier, use IR_TIMER2_CARRIER");
+            
+            for (; periods; periods--)
+            {
+                HalPortPin<Pin>::high();
+                halDelayCycles<IR_CARRIER_DELAY(IR_PORT_WRITE_CYCLES)>();
+                HalPortPin<Pin>::low();
+                halDelayCycles<IR_CARRIER_DELAY(IR_PORT_WRITE_CYCLES + IR_LOOP_CYCLES)>();
+                halLoopCycles<IR_LOOP_CYCLES>();
+            }
+        }
+#endif
+};
+
+#endif
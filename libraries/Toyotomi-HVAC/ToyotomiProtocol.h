@@ -0,0 +1,143 @@
+/*
+ * ToyotomiProtocol.h - Toyotomi HVAC Remote Control Library
+ * 
+ * The Toyotomi (Midea-style) IR protocol: command words, the tables that
+ * build them, and ToyotomiProtocol, the traits class the transmit engine in
+ * ToyotomiEngine.h is instantiated with. Another brand gets its own header
+ * of this kind and its own traits class.
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef TOYOTOMI_PROTOCOL_H
+#define TOYOTOMI_PROTOCOL_H
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+#else
+#include <stdint.h>
+#define PROGMEM
+#endif
+
+#define DEFAULT_MASK   0xFF8000
+#define TEMP_MASK      0x00000F
+#define MODE_MASK      0x000030
+#define FANSPEED_MASK  0x000700
+#define COMMAND_MASK   0xFFFFFF
+#define LASTKEY_MASK   0x0000E0
+#define TIMENCOM_MASK  0x000001
+#define TIMONTIM_MASK  0x0000FE
+#define TIMOFFTIM_MASK 0x0078C0
+#define ONTIMER_MASK   0x000080
+#define INVERTED_MASK  0xFFFF00
+
+#define DEFAULT_HEAD   0x4D8000
+#define POWER_OFF      0x4DDE07
+#define AIR_DIRECTION  0x4DF007
+#define SWING          0x4DD607
+#define CLEAN_AIR      0xADAFC5
+#define LED_DISPLAY    0xADAFA5
+#define TURBO          0xADAF45
+#define SLEEP          0x647EA0
+
+#define ONTIMERVAL     0x000080
+#define NOTIMONVAL     0x0000FE
+
+#define NOTEMP         0
+
+enum Mode      { AUTO, COOL, DRY, HEAT, FAN };
+enum FanSpeed  { NONE_SP, DEFAULT_SP, LOW_SP, MED_SP, HIGH_SP };
+enum TimerTime { HOUR000, HOUR005, HOUR010, HOUR015, HOUR020, HOUR025, HOUR030, HOUR035, HOUR040,
+                 HOUR045, HOUR050, HOUR055, HOUR060, HOUR065, HOUR070, HOUR075, HOUR080, HOUR085,
+                 HOUR090, HOUR095, HOUR100, HOUR110, HOUR120, HOUR130, HOUR140, HOUR150, HOUR160,
+                 HOUR170, HOUR180, HOUR190, HOUR200, HOUR210, HOUR220, HOUR230, HOUR240 };
+
+constexpr uint32_t tempMap[] PROGMEM     = { 0x000000, 0x000008, 0x00000C, 0x000004, 0x000006,
+                                              0x00000E, 0x00000A, 0x000002, 0x000003, 0x00000B,
+                                              0x000009, 0x000001, 0x000005, 0x00000D, 0x000007 };
+constexpr uint32_t modeMap[] PROGMEM     = { 0x000010, 0x000000, 0x000020, 0x000030, 0x000020 };
+constexpr uint32_t fanSpeedMap[] PROGMEM = { 0x000000, 0x000500, 0x000100, 0x000200, 0x000400 };
+constexpr uint32_t timerOnMap[] PROGMEM  = { 0x000040, 0x000000, 0x000040, 0x000020, 0x000060,
+                                              0x000010, 0x000050, 0x000030, 0x000070, 0x000008,
+                                              0x000048, 0x000028, 0x000068, 0x000018, 0x000058,
+                                              0x000038, 0x000078, 0x000004, 0x000044, 0x000024,
+                                              0x000064, 0x000054, 0x000074, 0x00004c, 0x00006c,
+                                              0x00005c, 0x00007c, 0x000042, 0x000062, 0x000052,
+                                              0x000072, 0x00004a, 0x00006a, 0x00005a, 0x00007a };     
+constexpr uint32_t timerOffMap[] PROGMEM = { 0x007800, 0x000000, 0x004000, 0x002000, 0x006000,
+                                              0x001000, 0x005000, 0x003000, 0x007000, 0x000800,
+                                              0x004800, 0x002800, 0x006800, 0x001800, 0x005800,
+                                              0x003800, 0x007800, 0x000080, 0x004080, 0x002080,
+                                              0x006080, 0x005080, 0x007080, 0x004880, 0x006880,
+                                              0x005880, 0x007880, 0x004040, 0x006040, 0x005040,
+                                              0x007040, 0x004840, 0x006840, 0x005840, 0x007840 };
+
+#define MIN_TEMP         17
+#define MAX_TEMP         30
+
+#define DEFAULT_DATA_LEN 48
+#define CYCLE_TIME       26
+#define PULSE_CYCLES     21
+#define IR_FRAME_LEN     (DEFAULT_DATA_LEN / 8)
+
+/*
+ * Frame format. A frame is a header, the data bits (LSB first in each byte)
+ * and a trailer; symbol 0 is the header, 1 .. dataBits the bits and the last
+ * one the trailer. Each symbol is a mark followed by a space, both measured
+ * in units of unitPeriods carrier periods (unitUs microseconds).
+ */
+struct ToyotomiProtocol
+{
+    static constexpr long carrierHz = 38000L;
+    static constexpr uint16_t unitUs = CYCLE_TIME * PULSE_CYCLES;
+    static constexpr uint8_t unitPeriods = PULSE_CYCLES;
+    static constexpr uint8_t dataBits = DEFAULT_DATA_LEN;
+    static constexpr uint8_t frameBytes = IR_FRAME_LEN;
+    static constexpr uint8_t symbols = DEFAULT_DATA_LEN + 2;
+    
+    static inline uint8_t mark(const uint8_t _symbol)
+    {
+        return _symbol == 0 ? 8 : 1;
+    }
+    
+    static inline uint8_t space(const uint8_t _data[], const uint8_t _symbol)
+    {
+        uint8_t _bit = _symbol - 1;
+        
+        if (_symbol == 0)
+            return 8;
+        if (_symbol > dataBits)
+            return 10;
+        
+        return _data[_bit >> 3] & (1 << (_bit & 7)) ? 3 : 1;
+    }
+    
+    // check word of a command without timers
+    static inline uint32_t check(const uint32_t _word)
+    {
+        return ~_word;
+    }
+    
+    // check word of a state with a timer; _onTimer is its timerOnMap entry
+    static inline uint32_t timerCheck(const uint32_t _word, const uint32_t _onTimer)
+    {
+        return (~_word & INVERTED_MASK) |
+               (_word & TIMENCOM_MASK) |
+               (ONTIMER_MASK & ONTIMERVAL) |
+               (TIMONTIM_MASK & _onTimer);
+    }
+    
+    // each byte of the command word is followed by the matching check byte
+    static inline void encode(const uint32_t _word, const uint32_t _check, uint8_t _frame[])
+    {
+        _frame[0] = _word >> 16;
+        _frame[1] = _check >> 16;
+        _frame[2] = _word >> 8;
+        _frame[3] = _check >> 8;
+        _frame[4] = _word;
+        _frame[5] = _check;
+    }
+};
+
+#endif
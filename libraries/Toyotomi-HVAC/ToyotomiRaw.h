@@ -0,0 +1,123 @@
+/*
+ * ToyotomiRaw.h - Toyotomi HVAC Remote Control Library
+ *
+ * Run-length encoded raw timing of a transmitted frame, written by the node
+ * (SERIAL_DEBUG) and read by extras/raw, which turns it into Pronto hex and
+ * LIRC raw codes. A record is
+ *
+ *     IR_RAW_MAGIC, carrier in Hz (2 bytes), unit in us (2 bytes),
+ *     body, IR_RAW_END
+ *
+ * with multi-byte values low byte first. Each body byte below 0x80 is one
+ * mark/space pair, the mark in units - 1 in bits 4 - 6 and the space in
+ * units in bits 0 - 3; a byte 0x80 | n repeats the previous pair n more
+ * times. Marks of 1 - 8 and spaces of 0 - 15 units fit, which covers every
+ * ToyotomiProtocol symbol. A frame sent twice is about 70 bytes.
+ *
+ * Release into the public domain.
+*/
+
+#ifndef TOYOTOMI_RAW_H
+#define TOYOTOMI_RAW_H
+
+#include "ToyotomiProtocol.h"
+
+#define IR_RAW_MAGIC      0x52
+#define IR_RAW_END        0x80
+#define IR_RAW_REPEAT     0x80
+#define IR_RAW_MAX_REPEAT 0x7F
+#define IR_RAW_HEADER_LEN 5
+
+struct IRRawRecord
+{
+    uint16_t carrierHz;
+    uint16_t unitUs;
+    const uint8_t *body;        // up to, not including, IR_RAW_END
+    uint16_t bodyLen;
+};
+
+struct IRRaw
+{
+    /*
+     * Streams the record of _data sent _passes times to _sink, one byte per
+     * call, so the node needs no buffer for it.
+     */
+    template <class Protocol, class Sink>
+    static void encode(const uint8_t _data[], const uint8_t _passes, Sink _sink)
+    {
+        uint8_t _pair, _last = IR_RAW_END, _repeat = 0;
+
+        _sink(IR_RAW_MAGIC);
+        _sink((uint8_t)Protocol::carrierHz);
+        _sink((uint8_t)(Protocol::carrierHz >> 8));
+        _sink((uint8_t)Protocol::unitUs);
+        _sink((uint8_t)(Protocol::unitUs >> 8));
+
+        for (uint8_t _pass = 0; _pass < _passes; _pass++)
+        {
+            for (uint8_t _symbol = 0; _symbol < Protocol::symbols; _symbol++)
+            {
+                _pair = ((Protocol::mark(_symbol) - 1) << 4) | Protocol::space(_data, _symbol);
+                if (_pair == _last && _repeat < IR_RAW_MAX_REPEAT)
+                {
+                    _repeat++;
+                    continue;
+                }
+
+                if (_repeat)
+                    _sink(IR_RAW_REPEAT | _repeat);
+                _sink(_pair);
+                _last = _pair;
+                _repeat = 0;
+            }
+        }
+        if (_repeat)
+            _sink(IR_RAW_REPEAT | _repeat);
+        _sink(IR_RAW_END);
+    }
+
+    // bytes of the record at the start of _in, 0 if there is no complete one
+    static inline uint16_t parse(const uint8_t _in[], const uint16_t _len, IRRawRecord &_record)
+    {
+        uint16_t _end = IR_RAW_HEADER_LEN;
+
+        if (_len < IR_RAW_HEADER_LEN || _in[0] != IR_RAW_MAGIC)
+            return 0;
+
+        while (_end < _len && _in[_end] != IR_RAW_END)
+            _end++;
+        if (_end == _len)
+            return 0;
+
+        _record.carrierHz = _in[1] | (_in[2] << 8);
+        _record.unitUs = _in[3] | (_in[4] << 8);
+        _record.body = _in + IR_RAW_HEADER_LEN;
+        _record.bodyLen = _end - IR_RAW_HEADER_LEN;
+
+        return _end + 1;
+    }
+
+    // calls _pair(mark, space) in units for every pair of the record
+    template <class PairFn>
+    static void expand(const IRRawRecord &_record, PairFn _pair)
+    {
+        uint8_t _mark = 0, _space = 0;
+
+        for (uint16_t i = 0; i < _record.bodyLen; i++)
+        {
+            uint8_t _byte = _record.body[i];
+
+            if (!(_byte & IR_RAW_REPEAT))
+            {
+                _mark = (_byte >> 4) + 1;
+                _space = _byte & 0x0F;
+                _pair(_mark, _space);
+                continue;
+            }
+            for (uint8_t n = _byte & IR_RAW_MAX_REPEAT; n && _mark; n--)
+                _pair(_mark, _space);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * BenchCommands.h - Command sequence timed by the waveform benchmark
+ * 
+ * BENCH_COMMANDS(X, t) expands X(name, call) once per public command, in
+ * the order the firmware runs them. The firmware and the host drivers
+ * expand it differently; the runner only uses the names.
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef BENCH_COMMANDS_H
+#define BENCH_COMMANDS_H
+
+#define BENCH_COMMANDS(X, t) \
+    X(powerOn,            t.powerOn()) \
+    X(setTemperature,     t.setTemperature(24)) \
+    X(setMode,            t.setMode(COOL)) \
+    X(setFanSpeed,        t.setFanSpeed(HIGH_SP)) \
+    X(buttonTempUp,       t.buttonTempUp()) \
+    X(buttonTempDown,     t.buttonTempDown()) \
+    X(buttonMode,         t.buttonMode()) \
+    X(buttonFanSpeed,     t.buttonFanSpeed()) \
+    X(setTimerOff,        t.setTimerOff(HOUR030)) \
+    X(setTimerOn,         t.setTimerOn(HOUR050)) \
+    X(buttonTimerOff,     t.buttonTimerOff()) \
+    X(buttonTimerOn,      t.buttonTimerOn()) \
+    X(buttonSwing,        t.buttonSwing()) \
+    X(buttonAirDirection, t.buttonAirDirection()) \
+    X(buttonCleanAir,     t.buttonCleanAir()) \
+    X(buttonLedDisplay,   t.buttonLedDisplay()) \
+    X(buttonTurbo,        t.buttonTurbo()) \
+    X(setState,           t.setState(22, HEAT, MED_SP)) \
+    X(commit,             (t.beginUpdate(), t.setMode(FAN), t.setFanSpeed(LOW_SP), t.commit())) \
+    X(powerOff,           t.powerOff()) \
+    X(buttonOnOff,        t.buttonOnOff()) \
+    X(buttonOff,          t.buttonOff())
+
+#define BENCH_DONE 0xFF
+
+#endif
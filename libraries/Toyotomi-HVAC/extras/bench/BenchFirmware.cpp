@@ -0,0 +1,43 @@
+/*
+ * BenchFirmware.cpp - AVR side of the waveform benchmark
+ * 
+ * Runs every command of BENCH_COMMANDS once, writing its index to GPIOR0
+ * first so the simulator can tell the frames apart, then BENCH_DONE, and
+ * stops the CPU.
+ * 
+ * Release into the public domain.
+*/
+
+#include <Toyotomi.h>
+#include <ToyotomiPin.h>
+#include <avr/sleep.h>
+#include "BenchCommands.h"
+
+#ifdef BENCH_PORT_PIN
+ToyotomiPin<DEFAULT_LED_PIN> toyo;
+#else
+Toyotomi toyo;
+#endif
+
+#define BENCH_RUN(_name, _call) \
+    GPIOR0 = _id++; \
+    _call; \
+    while (toyo.isTransmitting()) \
+        ;
+
+void setup()
+{
+    uint8_t _id = 0;
+    
+    BENCH_COMMANDS(BENCH_RUN, toyo)
+    
+    GPIOR0 = BENCH_DONE;
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    cli();
+    sleep_cpu();    // simavr ends the run on sleep with interrupts off
+}
+
+void loop()
+{
+}
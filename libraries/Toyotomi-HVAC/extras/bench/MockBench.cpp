@@ -0,0 +1,116 @@
+/*
+ * MockBench.cpp - Runs the benchmark command sequence on the host HAL mock
+ * 
+ * Usage: mockbench <mode> <report.json>
+ * 
+ * Same sequence and report format as SimBench, but timed by the mock's
+ * virtual clock, where only delays and the modelled pin write and loop
+ * cycles count. The result is the timing the library asks for; the simavr
+ * run shows what it gets. Carrier marks of the Timer2 modes are expanded
+ * into pin edges at the frequency decoded from the Timer2 registers. The
+ * run fails if a command's carrier is off by more than IR_CLOCK_TOLERANCE.
+ * 
+ * The serial port is flooded at BENCH_UART_BAUD throughout; the overruns
+ * the library counted, the longest interrupts-off window and the share of
+ * the time not spent in Toyotomi::idle() are printed.
+ * 
+ * Release into the public domain.
+*/
+
+#include <Toyotomi.h>
+#include <ToyotomiPin.h>
+#include <MockHal.h>
+#include <Timer2Mock.h>
+#include "BenchCommands.h"
+#include "Waveform.h"
+
+#define BENCH_UART_BAUD 38400
+
+#define BENCH_NAME(_name, _call) #_name,
+#define BENCH_RUN(_name, _call) \
+    _markers.push_back(mockHalCycles()); \
+    _call; \
+    while (toyo.isTransmitting()) \
+        Toyotomi::idle();
+
+static const char *benchNames[] = { BENCH_COMMANDS(BENCH_NAME, t) };
+
+static std::vector<WaveEdge> _pinEdges(void)
+{
+    const std::vector<MockEdge> &_mock = mockHalEdges();
+    std::vector<WaveEdge> _edges;
+    double _hz = timer2ConfiguredHz(F_CPU);
+    uint64_t _half = _hz ? F_CPU / (2 * _hz) : 1;
+    
+    for (size_t i = 0; i < _mock.size(); i++)
+    {
+        if (!_mock[i].carrier)
+        {
+            WaveEdge _edge = { _mock[i].cycle, _mock[i].level };
+            _edges.push_back(_edge);
+            continue;
+        }
+        
+        uint64_t _end = i + 1 < _mock.size() ? _mock[i + 1].cycle : _mock[i].cycle;
+        for (uint64_t _cycle = _mock[i].cycle; _cycle < _end; _cycle += 2 * _half)
+        {
+            WaveEdge _rise = { _cycle, 1 };
+            WaveEdge _fall = { _cycle + _half < _end ? _cycle + _half : _end, 0 };
+            _edges.push_back(_rise);
+            _edges.push_back(_fall);
+        }
+    }
+    
+    return _edges;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<uint64_t> _markers;
+    std::vector<WaveEdge> _edges;
+    FILE *_out;
+    int _status = 0;
+    
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s <mode> <report.json>\n", argv[0]);
+        return 2;
+    }
+    
+    mockHalReset();
+    mockHalUartFlood(BENCH_UART_BAUD);
+#ifdef BENCH_PORT_PIN
+    ToyotomiPin<DEFAULT_LED_PIN> toyo;
+#else
+    Toyotomi toyo;
+#endif
+    
+    BENCH_COMMANDS(BENCH_RUN, toyo)
+    _markers.push_back(mockHalCycles());
+    _edges = _pinEdges();
+    
+    if (!(_out = fopen(argv[2], "w")))
+    {
+        perror(argv[2]);
+        return 1;
+    }
+    writeReportHeader(_out, F_CPU, argv[1]);
+    for (size_t i = 0; i + 1 < _markers.size(); i++)
+    {
+        WaveReport _report;
+        
+        analyseWaveform(_edges, F_CPU, _markers[i], _markers[i + 1], _report);
+        writeReport(_out, benchNames[i], _report, i + 2 == _markers.size());
+        if (!carrierInTolerance(_report))
+        {
+            fprintf(stderr, "%s: %s: carrier at %.1f Hz\n", argv[1], benchNames[i], _report.carrierHz);
+            _status = 1;
+        }
+    }
+    writeReportFooter(_out);
+    fclose(_out);
+    printf("%s: %u uart overruns, interrupts off for at most %.0f us, awake %u permille\n", argv[1],
+           toyo.getUartOverruns(), mockHalIrqOffLongest() * 1e6 / F_CPU, Toyotomi::takeAwakePermille());
+    
+    return _status;
+}
@@ -0,0 +1,117 @@
+/*
+ * SimBench.cpp - Runs BenchFirmware under simavr and reports its timing
+ * 
+ * Usage: simbench <firmware.elf> <f_cpu> <port><bit> <mode> <report.json>
+ * 
+ * Every level change of the IR pin is captured with the simulated cycle
+ * count, split per command at the GPIOR0 markers written by the firmware
+ * and handed to analyseWaveform().
+ * 
+ * Release into the public domain.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_ioport.h>
+#include "BenchCommands.h"
+#include "Waveform.h"
+
+#define GPIOR0_ADDR  0x3E      // data space address of GPIOR0 on the ATmega328P
+
+#define BENCH_NAME(_name, _call) #_name,
+
+static const char *benchNames[] = { BENCH_COMMANDS(BENCH_NAME, t) };
+
+struct SimContext
+{
+    avr_t *avr;
+    std::vector<WaveEdge> edges;
+    std::vector<uint64_t> markers;
+    bool done;
+};
+
+static void _pinChanged(struct avr_irq_t *, uint32_t value, void *param)
+{
+    SimContext *_ctx = (SimContext *)param;
+    WaveEdge _edge = { _ctx->avr->cycle, (uint8_t)(value != 0) };
+    
+    _ctx->edges.push_back(_edge);
+}
+
+static void _markerWritten(struct avr_t *avr, avr_io_addr_t addr, uint8_t value, void *param)
+{
+    SimContext *_ctx = (SimContext *)param;
+    
+    avr->data[addr] = value;
+    _ctx->markers.push_back(avr->cycle);
+    if (value == BENCH_DONE)
+        _ctx->done = true;
+}
+
+int main(int argc, char *argv[])
+{
+    elf_firmware_t _firmware = {};
+    SimContext _ctx;
+    unsigned long _fcpu;
+    FILE *_out;
+    
+    if (argc != 6 || argv[3][0] < 'B' || argv[3][0] > 'D')
+    {
+        fprintf(stderr, "usage: %s <firmware.elf> <f_cpu> <port><bit> <mode> <report.json>\n", argv[0]);
+        return 2;
+    }
+    _fcpu = strtoul(argv[2], NULL, 0);
+    
+    if (elf_read_firmware(argv[1], &_firmware))
+    {
+        fprintf(stderr, "%s: cannot load %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    _firmware.frequency = _fcpu;
+    
+    _ctx.avr = avr_make_mcu_by_name("atmega328p");
+    _ctx.done = false;
+    avr_init(_ctx.avr);
+    avr_load_firmware(_ctx.avr, &_firmware);
+    _ctx.avr->frequency = _fcpu;
+    
+    avr_irq_register_notify(avr_io_getirq(_ctx.avr, AVR_IOCTL_IOPORT_GETIRQ(argv[3][0]), atoi(argv[3] + 1)),
+                            _pinChanged, &_ctx);
+    avr_register_io_write(_ctx.avr, GPIOR0_ADDR, _markerWritten, &_ctx);
+    
+    while (!_ctx.done)
+    {
+        int _state = avr_run(_ctx.avr);
+        
+        if (_state == cpu_Done || _state == cpu_Crashed)
+            break;
+    }
+    
+    if (!_ctx.done || _ctx.markers.size() != sizeof(benchNames) / sizeof(benchNames[0]) + 1)
+    {
+        fprintf(stderr, "%s: firmware stopped after %zu of %zu commands\n", argv[0],
+                _ctx.markers.size(), sizeof(benchNames) / sizeof(benchNames[0]));
+        return 1;
+    }
+    
+    if (!(_out = fopen(argv[5], "w")))
+    {
+        perror(argv[5]);
+        return 1;
+    }
+    writeReportHeader(_out, _fcpu, argv[4]);
+    for (size_t i = 0; i + 1 < _ctx.markers.size(); i++)
+    {
+        WaveReport _report;
+        
+        analyseWaveform(_ctx.edges, _fcpu, _ctx.markers[i], _ctx.markers[i + 1], _report);
+        writeReport(_out, benchNames[i], _report, i + 2 == _ctx.markers.size());
+    }
+    writeReportFooter(_out);
+    fclose(_out);
+    
+    return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ * Waveform.cpp - Timing analysis of a captured IR LED waveform
+ * 
+ * Release into the public domain.
+*/
+
+#include "Waveform.h"
+#include <Toyotomi.h>
+#include <math.h>
+
+#define UNIT_US          (CYCLE_TIME * PULSE_CYCLES)
+
+static const char *symbolNames[SYMBOL_CLASSES] = { "header_mark", "header_space", "bit_mark",
+                                                    "zero_space", "one_space", "trailer_space" };
+static const double symbolUnits[SYMBOL_CLASSES] = { 8, 8, 1, 1, 3, 10 };
+
+static void _addSymbol(WaveReport &_report, SymbolClass _class, double _us)
+{
+    SymbolStats &_stats = _report.symbols[_class];
+    
+    if (!_stats.count || _us < _stats.min)
+        _stats.min = _us;
+    if (!_stats.count || _us > _stats.max)
+        _stats.max = _us;
+    _stats.sum += _us;
+    _stats.count++;
+}
+
+void analyseWaveform(const std::vector<WaveEdge> &_edges, unsigned long fcpu,
+                     uint64_t begin, uint64_t end, WaveReport &_report)
+{
+    const double _usPerCycle = 1e6 / fcpu;
+    // a gap longer than two carrier periods ends a mark
+    const uint64_t _gap = 2 * fcpu / IR_CLOCK_RATE;
+    std::vector<uint64_t> _markStart, _markEnd;
+    std::vector<double> _periods;
+    double _highSum = 0, _periodSum = 0;
+    uint64_t _lastRise = 0, _lastFall = 0;
+    
+    _report = WaveReport();
+    for (unsigned i = 0; i < SYMBOL_CLASSES; i++)
+        _report.symbols[i].nominal = symbolUnits[i] * UNIT_US;
+    _report.busyUs = (end - begin) * _usPerCycle;
+    
+    // marks, and the carrier periods inside them
+    for (size_t i = 0; i < _edges.size(); i++)
+    {
+        const WaveEdge &_edge = _edges[i];
+        
+        if (_edge.cycle < begin || _edge.cycle >= end)
+            continue;
+        
+        if (!_edge.level)
+        {
+            _lastFall = _edge.cycle;
+            if (_markStart.size())
+                _markEnd.back() = _lastFall;
+            continue;
+        }
+        
+        if (_markStart.size() && _edge.cycle - _lastFall <= _gap)
+        {
+            _periods.push_back(_edge.cycle - _lastRise);
+            _periodSum += _edge.cycle - _lastRise;
+            _highSum += _lastFall - _lastRise;
+        }
+        else
+        {
+            _markStart.push_back(_edge.cycle);
+            _markEnd.push_back(_edge.cycle);
+        }
+        _lastRise = _edge.cycle;
+    }
+    
+    _report.marks = _markStart.size();
+    if (!_report.marks)
+        return;
+    _report.airtimeUs = (_markEnd.back() - _markStart.front()) * _usPerCycle;
+    
+    _report.carrierPeriods = _periods.size();
+    if (_periods.size())
+    {
+        double _mean = _periodSum / _periods.size();
+        
+        _report.carrierHz = fcpu / _mean;
+        _report.duty = _highSum / _periodSum;
+        for (size_t i = 0; i < _periods.size(); i++)
+            _report.carrierJitterUs = fmax(_report.carrierJitterUs, fabs(_periods[i] - _mean) * _usPerCycle);
+    }
+    
+    // Symbols are classified by their position in the frame (header, data
+    // bits, trailer), so a badly distorted mark still lands in its class.
+    // The last space runs up to the command return.
+    for (size_t i = 0; i < _markStart.size(); i++)
+    {
+        unsigned _position = i % (DEFAULT_DATA_LEN + 2);
+        double _mark = (_markEnd[i] - _markStart[i]) * _usPerCycle;
+        double _space = ((i + 1 < _markStart.size() ? _markStart[i + 1] : end) - _markEnd[i]) * _usPerCycle;
+        
+        if (_position == 0)
+        {
+            _addSymbol(_report, HEADER_MARK, _mark);
+            _addSymbol(_report, HEADER_SPACE, _space);
+        }
+        else if (_position == DEFAULT_DATA_LEN + 1)
+        {
+            _addSymbol(_report, BIT_MARK, _mark);
+            _addSymbol(_report, TRAILER_SPACE, _space);
+        }
+        else
+        {
+            _addSymbol(_report, BIT_MARK, _mark);
+            _addSymbol(_report, _space > 2 * UNIT_US ? ONE_SPACE : ZERO_SPACE, _space);
+        }
+    }
+    
+    for (unsigned i = 0; i < SYMBOL_CLASSES; i++)
+    {
+        const SymbolStats &_stats = _report.symbols[i];
+        
+        if (!_stats.count)
+            continue;
+        _report.worstErrorUs = fmax(_report.worstErrorUs, fabs(_stats.min - _stats.nominal));
+        _report.worstErrorUs = fmax(_report.worstErrorUs, fabs(_stats.max - _stats.nominal));
+        _report.worstJitterUs = fmax(_report.worstJitterUs, _stats.max - _stats.min);
+    }
+}
+
+// within IR_CLOCK_TOLERANCE of IR_CLOCK_RATE, or no carrier measured
+bool carrierInTolerance(const WaveReport &_report)
+{
+    if (!_report.carrierPeriods)
+        return true;
+    
+    return fabs(_report.carrierHz - IR_CLOCK_RATE) * 100 <= IR_CLOCK_TOLERANCE * IR_CLOCK_RATE;
+}
+
+void writeReportHeader(FILE *_out, unsigned long fcpu, const char *mode)
+{
+    fprintf(_out, "{\n  \"f_cpu\": %lu,\n  \"mode\": \"%s\",\n  \"unit_us\": %d,\n"
+                  "  \"nominal_carrier_hz\": %ld,\n  \"commands\": [\n",
+            fcpu, mode, UNIT_US, (long)IR_CLOCK_RATE);
+}
+
+void writeReport(FILE *_out, const char *name, const WaveReport &_report, bool last)
+{
+    fprintf(_out, "    {\n      \"name\": \"%s\",\n      \"marks\": %u,\n"
+                  "      \"carrier_hz\": %.1f,\n      \"duty\": %.3f,\n"
+                  "      \"carrier_jitter_us\": %.2f,\n      \"airtime_us\": %.1f,\n"
+                  "      \"busy_us\": %.1f,\n      \"worst_error_us\": %.1f,\n"
+                  "      \"worst_jitter_us\": %.1f,\n      \"symbols\": {",
+            name, _report.marks, _report.carrierHz, _report.duty, _report.carrierJitterUs,
+            _report.airtimeUs, _report.busyUs, _report.worstErrorUs, _report.worstJitterUs);
+    
+    for (unsigned i = 0, n = 0; i < SYMBOL_CLASSES; i++)
+    {
+        const SymbolStats &_stats = _report.symbols[i];
+        
+        if (!_stats.count)
+            continue;
+        fprintf(_out, "%s\n        \"%s\": { \"count\": %u, \"nominal_us\": %.0f, \"mean_error_us\": %.1f, "
+                      "\"min_error_us\": %.1f, \"max_error_us\": %.1f }",
+                n++ ? "," : "", symbolNames[i], _stats.count, _stats.nominal,
+                _stats.sum / _stats.count - _stats.nominal, _stats.min - _stats.nominal,
+                _stats.max - _stats.nominal);
+    }
+    fprintf(_out, "\n      }\n    }%s\n", last ? "" : ",");
+}
+
+void writeReportFooter(FILE *_out)
+{
+    fprintf(_out, "  ]\n}\n");
+}
@@ -0,0 +1,57 @@
+/*
+ * Waveform.h - Timing analysis of a captured IR LED waveform
+ * 
+ * Takes the level changes of the IR pin, timestamped in CPU cycles, and
+ * measures them against the nominal protocol timing of Toyotomi.h: carrier
+ * frequency, duty cycle and period jitter, and per-symbol mark/space error.
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef WAVEFORM_H
+#define WAVEFORM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+struct WaveEdge
+{
+    uint64_t cycle;
+    uint8_t level;
+};
+
+enum SymbolClass { HEADER_MARK, HEADER_SPACE, BIT_MARK, ZERO_SPACE, ONE_SPACE, TRAILER_SPACE,
+                   SYMBOL_CLASSES };
+
+struct SymbolStats
+{
+    double nominal;         // us
+    unsigned count;
+    double sum;
+    double min;
+    double max;
+};
+
+struct WaveReport
+{
+    unsigned carrierPeriods;
+    double carrierHz;
+    double duty;
+    double carrierJitterUs;     // worst deviation of one period from the mean
+    unsigned marks;
+    double airtimeUs;           // first rising to last falling edge
+    double busyUs;              // command start to return
+    double worstErrorUs;        // worst |measured - nominal| over all symbols
+    double worstJitterUs;       // widest max - min within one symbol class
+    SymbolStats symbols[SYMBOL_CLASSES];
+};
+
+void analyseWaveform(const std::vector<WaveEdge> &, unsigned long fcpu,
+                     uint64_t begin, uint64_t end, WaveReport &);
+bool carrierInTolerance(const WaveReport &);
+void writeReportHeader(FILE *, unsigned long fcpu, const char *mode);
+void writeReport(FILE *, const char *name, const WaveReport &, bool last);
+void writeReportFooter(FILE *);
+
+#endif
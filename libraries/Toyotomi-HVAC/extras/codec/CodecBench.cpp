@@ -0,0 +1,145 @@
+/*
+ * CodecBench.cpp - Toyotomi HVAC Remote Control Library
+ *
+ * Encodes and decodes every state the library can send: each temperature
+ * (and NOTEMP), mode, fan speed and on / off timer pair, with and without
+ * the timers in the check word. Every frame has to decode to the state it
+ * came from, up to the aliases listed in ToyotomiCodec.h, and to encode
+ * back to itself. The state space is split over the worker threads and
+ * walked a number of times; frames per second counts one encode plus one
+ * decode.
+ *
+ *   codec-bench [threads [passes]]
+ *
+ * Release into the public domain.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "ToyotomiCodec.h"
+
+#define TEMPS     (MAX_TEMP - MIN_TEMP + 2)     // MIN_TEMP .. MAX_TEMP and NOTEMP
+#define TIMERS    (HOUR240 + 1)
+#define STATES    ((unsigned)TEMPS * (FAN + 1) * (HIGH_SP + 1) * TIMERS * TIMERS)
+
+static std::atomic<unsigned long> errors(0);
+
+static ToyotomiState stateAt(unsigned i)
+{
+    ToyotomiState _state;
+
+    _state.timerOff = (TimerTime)(i % TIMERS);
+    i /= TIMERS;
+    _state.timerOn = (TimerTime)(i % TIMERS);
+    i /= TIMERS;
+    _state.fanSpeed = (FanSpeed)(i % (HIGH_SP + 1));
+    i /= HIGH_SP + 1;
+    _state.mode = (Mode)(i % (FAN + 1));
+    i /= FAN + 1;
+    _state.temperature = i == TEMPS - 1 ? NOTEMP : MIN_TEMP + i;
+
+    return _state;
+}
+
+// the state decode() gives back for a frame encoded from _state
+static ToyotomiState expected(ToyotomiState _state, const bool _timers)
+{
+    if (_state.temperature < MIN_TEMP || _state.temperature > MAX_TEMP)
+        _state.temperature = MIN_TEMP;
+    if (_state.mode == FAN)
+        _state.mode = DRY;
+    if (!_timers)
+        _state.timerOn = HOUR000;
+    if (_state.timerOff == HOUR080 && (!_timers || _state.timerOn != HOUR000))
+        _state.timerOff = HOUR000;
+
+    return _state;
+}
+
+static bool sameState(const ToyotomiState &_a, const ToyotomiState &_b)
+{
+    return _a.temperature == _b.temperature && _a.mode == _b.mode && _a.fanSpeed == _b.fanSpeed &&
+           _a.timerOn == _b.timerOn && _a.timerOff == _b.timerOff;
+}
+
+static void report(const unsigned i, const bool _withTimers, const uint8_t _frame[], const char *_what)
+{
+    ToyotomiState _state = stateAt(i);
+
+    fprintf(stderr, "state %u (temp %u mode %d fan %d on %d off %d%s): frame %02x%02x%02x%02x%02x%02x %s\n",
+            i, _state.temperature, _state.mode, _state.fanSpeed, _state.timerOn, _state.timerOff,
+            _withTimers ? "" : ", no timers", _frame[0], _frame[1], _frame[2], _frame[3], _frame[4],
+            _frame[5], _what);
+}
+
+static void roundTrip(const unsigned _first, const unsigned _last, const unsigned _passes)
+{
+    uint8_t _frame[IR_FRAME_LEN], _again[IR_FRAME_LEN];
+    ToyotomiState _state, _decoded;
+    FrameType _type;
+    bool _timers;
+
+    for (unsigned _pass = 0; _pass < _passes; _pass++)
+    {
+        for (unsigned i = _first; i < _last; i++)
+        {
+            _state = stateAt(i);
+            for (int _withTimers = 1; _withTimers >= 0; _withTimers--)
+            {
+                ToyotomiCodec::encode(_state, _frame, _withTimers);
+                _type = ToyotomiCodec::decode(_frame, _decoded);
+                _timers = _withTimers && (_state.timerOn != HOUR000 || _state.timerOff != HOUR000);
+
+                if (_type != (_timers ? TIMER_FRAME : STATE_FRAME))
+                {
+                    report(i, _withTimers, _frame, "has the wrong type");
+                    errors++;
+                    continue;
+                }
+                if (!sameState(_decoded, expected(_state, _timers)))
+                {
+                    report(i, _withTimers, _frame, "decodes to another state");
+                    errors++;
+                }
+                ToyotomiCodec::encode(_decoded, _again, _timers);
+                if (memcmp(_frame, _again, IR_FRAME_LEN))
+                {
+                    report(i, _withTimers, _frame, "does not encode back to itself");
+                    errors++;
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned _threads = argc > 1 ? atoi(argv[1]) : std::thread::hardware_concurrency();
+    unsigned _passes = argc > 2 ? atoi(argv[2]) : 20;
+    std::vector<std::thread> _workers;
+    double _seconds, _frames;
+
+    if (!_threads)
+        _threads = 1;
+
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    for (unsigned t = 0; t < _threads; t++)
+        _workers.push_back(std::thread(roundTrip, (unsigned long)STATES * t / _threads,
+                                       (unsigned long)STATES * (t + 1) / _threads, _passes));
+    for (unsigned t = 0; t < _threads; t++)
+        _workers[t].join();
+    _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+    _frames = 2.0 * STATES * _passes;
+    printf("{\"states\": %u, \"frames\": %.0f, \"threads\": %u, \"seconds\": %.3f, "
+           "\"frames_per_second\": %.0f, \"errors\": %lu}\n",
+           STATES, _frames, _threads, _seconds, _frames / _seconds, errors.load());
+
+    return errors ? 1 : 0;
+}
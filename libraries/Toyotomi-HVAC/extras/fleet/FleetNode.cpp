@@ -0,0 +1,304 @@
+/*
+ * FleetNode.cpp - One controller of the fleet simulator
+ *
+ * Release into the public domain.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+
+#include "FleetNode.h"
+#include "RadioChannel.h"
+
+FleetNode::FleetNode(const uint16_t _nodeId, const FleetPolicy &_nodePolicy, const uint32_t _upMs)
+    : _id(_nodeId), _board(_newBoard(_upMs)),
+      _bootCycle((uint64_t)_upMs * (F_CPU / 1000)),
+      toyo(DEFAULT_TEMP, AUTO, DEFAULT_SP, DEFAULT_TIMER, DEFAULT_TIMER, DEFAULT_POWER),
+      _commands(this->toyo, *this, _nodePolicy.coalesceWindow, _nodePolicy.report == STRING_REPORT)
+{
+    Task _table[TASKS] = {
+        { &FleetNode::_radioTask,     0,             0 },
+        { &FleetNode::_irTask,        0,             0 },
+        { &FleetNode::_heartbeatTask, 0,             0 },
+        { &FleetNode::_beaconTask,    BEACON_PERIOD, 0 },
+        { &FleetNode::_coalesceTask,  0,             0 }
+    };
+    
+    for (uint8_t i = 0; i < TASKS; i++)
+        this->_tasks[i] = _table[i];
+    this->commands = 0;
+    this->noFrame = 0;
+    this->frames = 0;
+    this->_issuedUs = 0;
+    this->_commandFrames = 0;
+    this->_windowFrames = 0;
+    this->_ledOn = false;
+    this->_uartFreeUs = 0;
+    this->_seq = 0;
+    this->_nowUs = 0;
+    this->_framesSeen = this->toyo.getFramesSent();
+    
+    // setup() ran and reported before the simulation starts
+    halPinOutput(LED_PIN);
+    this->toyo.takeChanges();
+    mockHalSelect(NULL);
+}
+
+FleetNode::~FleetNode()
+{
+    mockHalDeleteNode(this->_board);
+}
+
+// a board that has been up for _upMs, selected for the constructor
+MockHalNode *FleetNode::_newBoard(const uint32_t _upMs)
+{
+    MockHalNode *_board = mockHalNewNode();
+    
+    mockHalSelect(_board);
+    mockHalKeepEdges(false);
+    mockHalAdvance((uint64_t)_upMs * (F_CPU / 1000));
+    
+    return _board;
+}
+
+// called between steps only, commands arrive in the order they were issued
+void FleetNode::deliver(const FleetCommand &_command)
+{
+    this->_inbox.push_back(_command);
+}
+
+// runs the loop until the board's clock reaches _untilUs, or just past it
+void FleetNode::step(const uint64_t _untilUs)
+{
+    mockHalSelect(this->_board);
+    // the library's idle accounting is per thread, start it afresh for this board
+    Toyotomi::takeAwakePermille();
+    while (this->_usOf(mockHalCycles()) < _untilUs)
+    {
+        // the received bytes wake the board from IDLE sleep
+        mockHalWakeAt(this->_inbox.empty() ? 0 : this->_cycleOf(this->_inbox.front().deliveredUs));
+        this->_loop();
+    }
+    this->_nowUs = this->_usOf(mockHalCycles());
+    this->frames += (uint16_t)(this->toyo.getFramesSent() - this->_framesSeen);
+    this->_framesSeen = this->toyo.getFramesSent();
+    mockHalSelect(NULL);
+}
+
+uint64_t FleetNode::nowUs()
+{
+    return this->_nowUs;
+}
+
+
+void FleetNode::_loop()
+{
+    this->_runTasks();
+    Toyotomi::idle();
+}
+
+// runs every due task once, earliest deadline first
+void FleetNode::_runTasks()
+{
+    unsigned long _now = halMillis();
+    uint8_t _ran = 0;
+    int8_t _next;
+    
+    for (;;)
+    {
+        _next = -1;
+        for (uint8_t i = 0; i < TASKS; i++)
+            if (!(_ran & _BV(i)) && (long)(_now - this->_tasks[i].due) >= 0 &&
+                (_next < 0 || (long)(this->_tasks[i].due - this->_tasks[_next].due) < 0))
+                _next = i;
+        if (_next < 0)
+            return;
+        
+        _ran |= _BV(_next);
+        this->_runTask(this->_tasks[_next]);
+    }
+}
+
+void FleetNode::_runTask(Task &_task)
+{
+    unsigned long _start = halMicros();
+    unsigned long _wait = (this->*_task.run)();
+    unsigned long _took = halMicros() - _start;
+    
+    if (_took > _task.worstUs)
+        _task.worstUs = _took;
+    _task.due = halMillis() + _wait;
+}
+
+unsigned long FleetNode::_radioTask()
+{
+    FleetCommand _command;
+    
+    if (this->_inbox.empty() || this->_cycleOf(this->_inbox.front().deliveredUs) > mockHalCycles())
+        return 0;
+    
+    _command = this->_inbox.front();
+    this->_inbox.pop_front();
+    this->deliveryUs.push_back(_command.deliveredUs - _command.issuedUs);
+    if (_command.data[0] == 1)
+    {
+        this->_issuedUs = _command.issuedUs;
+        this->_commands.handle(_command.data);
+    }
+    
+    return 0;
+}
+
+// reports the state once the unit has been sent the frames for it
+unsigned long FleetNode::_irTask()
+{
+    if (this->_commands.isCoalescing() || this->toyo.isTransmitting())
+        return 0;
+    
+    this->_commands.sendState();
+    
+    return 0;
+}
+
+unsigned long FleetNode::_heartbeatTask()
+{
+    this->_ledOn = !this->_ledOn;
+    halPinWrite(LED_PIN, this->_ledOn ? HIGH : LOW);
+    
+    return this->_ledOn ? LED_FLASH : HEARTBEAT_PERIOD - LED_FLASH;
+}
+
+unsigned long FleetNode::_beaconTask()
+{
+    this->_ledOn = true;
+    halPinWrite(LED_PIN, HIGH);
+    this->_tasks[HEARTBEAT_TASK].due = halMillis() + LED_FLASH;
+    
+    this->_sendValue("report", "airconditioner");
+    this->_send(1 + 4 * TASKS + 2 + 2);
+    
+    return BEACON_PERIOD;
+}
+
+unsigned long FleetNode::_coalesceTask()
+{
+    this->_commands.closeWindow();
+    
+    return TASK_SLEEP;
+}
+
+// an uberdust text value: UBERDUST_TEXT, the name, a space and the value
+void FleetNode::_sendValue(const char *_name, const char *_value)
+{
+    this->_send(1 + strlen(_name) + 1 + strlen(_value));
+}
+
+/*
+ * xbee.send(): the API frame goes out over the UART behind whatever is
+ * still queued, and Serial.write() only blocks the loop while more than
+ * its buffer is waiting. The packet is the XBee's once its last byte is in.
+ */
+void FleetNode::_send(const uint8_t _length)
+{
+    uint64_t _now = this->_usOf(mockHalCycles());
+    uint64_t _buffered = SERIAL_TX_BUFFER * 10 * 1000000ULL / UART_BAUD;
+    FleetUplink _packet;
+    
+    if (this->_uartFreeUs < _now)
+        this->_uartFreeUs = _now;
+    this->_uartFreeUs += uartUs(_length);
+    if (this->_uartFreeUs - _now > _buffered)
+        halDelayUs(this->_uartFreeUs - _now - _buffered);
+    
+    _packet.queuedUs = this->_uartFreeUs;
+    _packet.node = this->_id;
+    _packet.seq = this->_seq++;
+    _packet.length = _length;
+    this->outbox.push_back(_packet);
+}
+
+// latency of a command issued at _issuedUs, if a frame went out since _framesBefore
+void FleetNode::_framesFor(const uint64_t _issuedUs, const uint16_t _framesBefore)
+{
+    uint64_t _now = mockHalCycles();
+    uint64_t _start;
+    
+    if (this->toyo.getFramesSent() == _framesBefore)
+    {
+        this->noFrame++;
+        return;
+    }
+    
+    _start = _now - (uint32_t)((uint32_t)_now - this->toyo.getLastFrameStart());
+    this->latencyUs.push_back(this->_usOf(_start) - _issuedUs);
+}
+
+uint64_t FleetNode::_usOf(const uint64_t _cycle)
+{
+    return (_cycle - this->_bootCycle) * 1000000ULL / F_CPU;
+}
+
+uint64_t FleetNode::_cycleOf(const uint64_t _us)
+{
+    return this->_bootCycle + (_us * F_CPU + 999999) / 1000000ULL;
+}
+
+
+void FleetNode::scheduleCommit(uint16_t _ms)
+{
+    this->_tasks[COALESCE_TASK].due = halMillis() + _ms;
+}
+
+void FleetNode::commandStarting(uint8_t)
+{
+    this->_commandFrames = this->toyo.getFramesSent();
+    this->commands++;
+}
+
+void FleetNode::commandDone(bool _windowed)
+{
+    if (_windowed)
+        this->_window.push_back(this->_issuedUs);
+    else
+        this->_framesFor(this->_issuedUs, this->_commandFrames);
+}
+
+void FleetNode::windowClosing()
+{
+    this->_windowFrames = this->toyo.getFramesSent();
+}
+
+void FleetNode::windowClosed()
+{
+    for (size_t i = 0; i < this->_window.size(); i++)
+        this->_framesFor(this->_window[i], this->_windowFrames);
+    this->_window.clear();
+}
+
+void FleetNode::sendStats(uint8_t _command)
+{
+    for (uint8_t i = 1; i <= STAT_COMMANDS; i++)
+        if (!_command || _command == i)
+            this->_send(2 + STATS_LEN);
+}
+
+void FleetNode::sendTrace()
+{
+    // the trace is per thread here, so the length is what this board's would have
+    uint32_t _sent = this->frames + (uint16_t)(this->toyo.getFramesSent() - this->_framesSeen);
+    
+    this->_send(1 + std::min<uint32_t>(_sent, IR_TRACE_LEN) * IR_TRACE_ENTRY_BYTES);
+}
+
+void FleetNode::sendPackedState(uint16_t, const PackedState &)
+{
+    this->_send(3 + sizeof(PackedState));
+}
+
+void FleetNode::sendValue(const char *_name, int _value)
+{
+    char _text[12];
+    
+    snprintf(_text, sizeof(_text), "%d", _value);
+    this->_sendValue(_name, _text);
+}
@@ -0,0 +1,146 @@
+/*
+ * FleetNode.h - One controller of the fleet simulator
+ *
+ * The loop of Toyotomi.ino - task table, state report and beacon - around
+ * a real Toyotomi on a mock board of its own (MockHalNode). Commands go
+ * through the sketch's own ToyotomiCommands, with the node as its Host.
+ * The sketch keeps its tasks in globals and picks its policies with
+ * macros, so one process can only run it once; here the reporting and
+ * coalescing policies are members and the XBee is an inbox the simulator
+ * fills and an outbox it empties between steps.
+ *
+ * A node also measures what the sketch cannot: the time from the
+ * coordinator issuing a command to the start of the IR frame it caused,
+ * for every command rather than only the first of a burst.
+ *
+ * Release into the public domain.
+*/
+
+#ifndef FLEET_NODE_H
+#define FLEET_NODE_H
+
+#include <deque>
+#include <vector>
+
+#include <MockHal.h>
+#include <Toyotomi.h>
+#include <ToyotomiCommands.h>
+
+#define STATE_REPORT     103
+#define TASK_REPORT      104
+#define STATS_REPORT     105
+#define TRACE_REPORT     106
+#define UBERDUST_TEXT    102
+
+#define STAT_COMMANDS    14
+#define STATS_LEN        34      // sizeof(CommandStats) in the sketch, on the AVR
+
+#define HEARTBEAT_PERIOD 5000    // ms
+#define LED_FLASH        100     // ms
+#define BEACON_PERIOD    60000   // ms
+#define TASK_SLEEP       0x7FFFFFFFUL
+
+#define LED_PIN          13
+#define SERIAL_TX_BUFFER 64      // bytes Serial.write() takes without blocking
+
+enum ReportPolicy { PACKED_REPORT, STRING_REPORT };
+
+struct FleetPolicy
+{
+    ReportPolicy report;
+    uint16_t coalesceWindow;    // ms, 0 sends a frame for every command
+};
+
+// a command from the coordinator, also what the node's XBee hands it
+struct FleetCommand
+{
+    uint64_t issuedUs;          // simulation time the coordinator sent it
+    uint64_t deliveredUs;       // last byte in the node's UART
+    uint16_t node;
+    uint8_t length;             // payload bytes, 1 and the command included
+    uint8_t data[5];            // 1, command, arguments
+};
+
+// a packet the node hands to its XBee
+struct FleetUplink
+{
+    uint64_t queuedUs;          // complete in the XBee
+    uint16_t node;
+    uint32_t seq;
+    uint8_t length;
+};
+
+class FleetNode
+{
+    public:
+        FleetNode(const uint16_t _nodeId, const FleetPolicy &_nodePolicy, const uint32_t _upMs);
+        ~FleetNode(void);
+        void deliver(const FleetCommand &);
+        void step(const uint64_t _untilUs);
+        uint64_t nowUs(void);
+        
+        std::vector<FleetUplink> outbox;    // oldest first
+        std::vector<uint32_t> latencyUs;    // command issued to IR frame start
+        std::vector<uint32_t> deliveryUs;   // command issued to delivered
+        uint32_t commands;
+        uint32_t noFrame;                   // commands that sent nothing (unchanged state)
+        uint32_t frames;
+    
+    private:
+        friend class ToyotomiCommands<FleetNode>;
+        
+        struct Task
+        {
+            unsigned long (FleetNode::*run)(void);
+            unsigned long due;
+            unsigned long worstUs;
+        };
+        
+        enum { RADIO_TASK, IR_TASK, HEARTBEAT_TASK, BEACON_TASK, COALESCE_TASK, TASKS };
+        
+        static MockHalNode *_newBoard(const uint32_t _upMs);
+        
+        void _loop(void);
+        void _runTasks(void);
+        void _runTask(Task &);
+        unsigned long _radioTask(void);
+        unsigned long _irTask(void);
+        unsigned long _heartbeatTask(void);
+        unsigned long _beaconTask(void);
+        unsigned long _coalesceTask(void);
+        void _sendValue(const char *_name, const char *_value);
+        void _send(const uint8_t _length);
+        void _framesFor(const uint64_t _issuedUs, const uint16_t _framesBefore);
+        uint64_t _usOf(const uint64_t _cycle);
+        uint64_t _cycleOf(const uint64_t _us);
+        
+        // the Host of _commands
+        void scheduleCommit(uint16_t _ms);
+        void commandStarting(uint8_t _command);
+        void commandDone(bool _windowed);
+        void windowClosing(void);
+        void windowClosed(void);
+        void sendStats(uint8_t _command);
+        void sendTrace(void);
+        void sendPackedState(uint16_t _changes, const PackedState &);
+        void sendValue(const char *_name, int _value);
+        
+        const uint16_t _id;
+        MockHalNode *_board;                // before toyo, which runs on it
+        uint64_t _bootCycle;                // board cycle at simulation time 0
+        Toyotomi toyo;
+        ToyotomiCommands<FleetNode> _commands;
+        Task _tasks[TASKS];
+        std::deque<FleetCommand> _inbox;
+        uint64_t _issuedUs;                 // of the command being handled
+        uint16_t _commandFrames;            // frames sent before it
+        std::vector<uint64_t> _window;      // issue times of the commands in the open window
+        uint16_t _windowFrames;             // frames sent before the window's commit
+        bool _ledOn;
+        uint64_t _uartFreeUs;               // when the UART has sent what is queued
+        uint32_t _seq;
+        uint64_t _nowUs;                    // where the last step() ended
+        uint16_t _framesSeen;
+};
+
+#endif
@@ -0,0 +1,348 @@
+/*
+ * FleetSim.cpp - Simulates a building of Toyotomi controllers on one radio
+ *
+ * Usage: fleet-sim [-t threads] [-n nodes] [-r packed,string] [-w 0,300,...]
+ *                  [-s settle_ms] trace
+ *        fleet-sim -g nodes minutes [seed]
+ *
+ * Replays a command trace - one "ms node command [arguments]" line per
+ * packet the coordinator sent, # starts a comment - against a FleetNode per
+ * controller and reports, for every combination of state report (-r) and
+ * coalescing window in ms (-w), the command throughput, the command to IR
+ * frame latency percentiles and the airtime of the shared channel, one
+ * JSON object per line. -g writes a synthetic trace instead: the building
+ * switched on at once, occupants adjusting their units in bursts, and the
+ * building switched off at the end.
+ *
+ * Time is one virtual clock, in us, that every board and the channel
+ * share. The boards run in parallel on a work-stealing pool up to the next
+ * barrier; there the packets queued before it are put on the channel in
+ * time order, uplinks and the coordinator's commands alike. A command
+ * cannot reach a board earlier than the shortest downlink - air time and
+ * the board's UART - after it was issued, so barriers that far apart
+ * still deliver every command before the board gets to it.
+ *
+ * Release into the public domain.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "FleetNode.h"
+#include "RadioChannel.h"
+#include "WorkPool.h"
+
+#define COORDINATOR      0xFFFF  // node number of the coordinator's packets on the channel
+#define MIN_COMMAND_LEN  2       // 1 and the command
+#define MAX_STEP_US      1000000ULL
+
+// issue to delivery of the shortest command, the longest distance between barriers
+#define LOOKAHEAD_US     (RADIO_CCA_US + (RADIO_OVERHEAD + MIN_COMMAND_LEN) * RADIO_BYTE_US + \
+                          RADIO_ACK_US + uartUs(MIN_COMMAND_LEN))
+
+static bool readTrace(const char *_path, std::vector<FleetCommand> &_trace, unsigned &_nodes)
+{
+    FILE *_file = fopen(_path, "r");
+    char _line[256];
+    unsigned _lineNo = 0;
+    
+    if (!_file)
+    {
+        perror(_path);
+        return false;
+    }
+    
+    while (fgets(_line, sizeof(_line), _file))
+    {
+        FleetCommand _command = FleetCommand();
+        unsigned long long _ms;
+        unsigned _node, _args[4];
+        int _fields;
+        
+        _lineNo++;
+        if (strchr(_line, '#'))
+            *strchr(_line, '#') = 0;
+        _fields = sscanf(_line, "%llu %u %u %u %u %u", &_ms, &_node, &_args[0], &_args[1], &_args[2], &_args[3]);
+        if (_fields <= 0)
+            continue;
+        if (_fields < 3 || _node >= COORDINATOR)
+        {
+            fprintf(stderr, "%s:%u: expected ms node command [arguments]\n", _path, _lineNo);
+            fclose(_file);
+            return false;
+        }
+        
+        _command.issuedUs = _ms * 1000;
+        _command.node = _node;
+        _command.length = _fields - 1;
+        _command.data[0] = 1;
+        for (int i = 0; i < _fields - 2; i++)
+            _command.data[1 + i] = _args[i];
+        _trace.push_back(_command);
+        if (_node >= _nodes)
+            _nodes = _node + 1;
+    }
+    fclose(_file);
+    
+    std::stable_sort(_trace.begin(), _trace.end(), [](const FleetCommand &_a, const FleetCommand &_b) {
+        return _a.issuedUs < _b.issuedUs;
+    });
+    
+    return true;
+}
+
+// the building on in the morning, occupants at their units, off in the evening
+static void writeTrace(const unsigned _nodes, const unsigned _minutes, const unsigned _seed)
+{
+    std::mt19937 _random(_seed);
+    std::vector<std::pair<uint64_t, std::string> > _lines;
+    uint64_t _end = _minutes * 60000ULL;
+    char _text[64];
+    
+    for (unsigned n = 0; n < _nodes; n++)
+    {
+        uint8_t _temp = 22;
+        uint64_t _at = 5000 + 20 * n;
+        
+        snprintf(_text, sizeof(_text), "%u 6", n);
+        _lines.push_back(std::make_pair(_at, std::string(_text)));
+        
+        // about one adjustment every 8 minutes
+        for (;;)
+        {
+            _at += std::exponential_distribution<double>(1.0 / 480000)(_random);
+            if (_at + 10000 > _end - 30000)
+                break;
+            
+            switch (_random() % 8)
+            {
+                case 0:
+                    snprintf(_text, sizeof(_text), "%u 2 %u", n, (unsigned)(_random() % 4));
+                    break;
+                case 1:
+                    snprintf(_text, sizeof(_text), "%u 3 %u", n, (unsigned)(2 + _random() % 3));
+                    break;
+                case 2:
+                    snprintf(_text, sizeof(_text), "%u %u", n, _random() % 2 ? 8 : 13);
+                    break;
+                default:
+                {
+                    // tapping the temperature up or down a few degrees
+                    int _step = _random() % 2 ? 1 : -1;
+                    unsigned _taps = 2 + _random() % 5;
+                    
+                    for (unsigned i = 0; i < _taps; i++, _at += 250 + _random() % 450)
+                    {
+                        if (_temp + _step >= MIN_TEMP && _temp + _step <= MAX_TEMP)
+                            _temp += _step;
+                        snprintf(_text, sizeof(_text), "%u 1 %u", n, _temp);
+                        _lines.push_back(std::make_pair(_at, std::string(_text)));
+                    }
+                    continue;
+                }
+            }
+            _lines.push_back(std::make_pair(_at, std::string(_text)));
+        }
+        
+        snprintf(_text, sizeof(_text), "%u 7", n);
+        _lines.push_back(std::make_pair(_end - 30000 + 20 * n, std::string(_text)));
+    }
+    
+    std::stable_sort(_lines.begin(), _lines.end(),
+                     [](const std::pair<uint64_t, std::string> &_a, const std::pair<uint64_t, std::string> &_b) {
+                         return _a.first < _b.first;
+                     });
+    printf("# fleet-sim -g %u %u %u\n", _nodes, _minutes, _seed);
+    for (size_t i = 0; i < _lines.size(); i++)
+        printf("%llu %s\n", (unsigned long long)_lines[i].first, _lines[i].second.c_str());
+}
+
+static double percentileMs(std::vector<uint32_t> &_sorted, const double _p)
+{
+    if (_sorted.empty())
+        return 0;
+    
+    return _sorted[std::min(_sorted.size() - 1, (size_t)(_p / 100 * _sorted.size()))] / 1000.0;
+}
+
+static void simulate(const std::vector<FleetCommand> &_trace, const unsigned _nodes, const FleetPolicy &_policy,
+                     const uint64_t _endUs, WorkPool &_pool)
+{
+    std::vector<FleetNode *> _fleet;
+    std::vector<FleetUplink> _held;     // queued, not yet on the channel
+    std::vector<uint32_t> _latency, _delivery;
+    RadioChannel _channel;
+    uint32_t _handled = 0, _noFrame = 0, _frames = 0, _steps = 0, _seq = 0;
+    uint64_t _now = 0, _until, _steals = _pool.steals();
+    size_t _next = 0;
+    
+    std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    for (unsigned n = 0; n < _nodes; n++)
+        _fleet.push_back(new FleetNode(n, _policy, (n * 7919UL * 7927UL) % BEACON_PERIOD));
+    
+    while (_now < _endUs)
+    {
+        _until = std::min<uint64_t>(_endUs, _now + MAX_STEP_US);
+        if (_next < _trace.size())
+            _until = std::min<uint64_t>(_until, std::max<uint64_t>(_now + 1, _trace[_next].issuedUs + LOOKAHEAD_US));
+        
+        _pool.run(_nodes, [&](size_t n) { _fleet[n]->step(_until); });
+        _steps++;
+        
+        for (unsigned n = 0; n < _nodes; n++)
+        {
+            _held.insert(_held.end(), _fleet[n]->outbox.begin(), _fleet[n]->outbox.end());
+            _fleet[n]->outbox.clear();
+        }
+        std::sort(_held.begin(), _held.end(), [](const FleetUplink &_a, const FleetUplink &_b) {
+            return _a.queuedUs != _b.queuedUs ? _a.queuedUs < _b.queuedUs :
+                   _a.node != _b.node ? _a.node < _b.node : _a.seq < _b.seq;
+        });
+        
+        size_t _up = 0;
+        
+        for (;;)
+        {
+            bool _upReady = _up < _held.size() && _held[_up].queuedUs < _until;
+            bool _downReady = _next < _trace.size() && _trace[_next].issuedUs < _until;
+            
+            if (_downReady && (!_upReady || _trace[_next].issuedUs <= _held[_up].queuedUs))
+            {
+                FleetCommand _command = _trace[_next++];
+                
+                _command.deliveredUs = _channel.transmit(_command.issuedUs, COORDINATOR, _seq++,
+                                                         _command.length, true) + uartUs(_command.length);
+                if (_command.node < _nodes)
+                    _fleet[_command.node]->deliver(_command);
+            }
+            else if (_upReady)
+            {
+                _channel.transmit(_held[_up].queuedUs, _held[_up].node, _held[_up].seq, _held[_up].length, false);
+                _up++;
+            }
+            else
+                break;
+        }
+        _held.erase(_held.begin(), _held.begin() + _up);
+        _now = _until;
+    }
+    double _wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    
+    for (unsigned n = 0; n < _nodes; n++)
+    {
+        _latency.insert(_latency.end(), _fleet[n]->latencyUs.begin(), _fleet[n]->latencyUs.end());
+        _delivery.insert(_delivery.end(), _fleet[n]->deliveryUs.begin(), _fleet[n]->deliveryUs.end());
+        _handled += _fleet[n]->commands;
+        _noFrame += _fleet[n]->noFrame;
+        _frames += _fleet[n]->frames;
+        delete _fleet[n];
+    }
+    std::sort(_latency.begin(), _latency.end());
+    std::sort(_delivery.begin(), _delivery.end());
+    
+    double _simS = _endUs / 1e6;
+    uint64_t _air = _channel.airUs[RADIO_UPLINK] + _channel.airUs[RADIO_DOWNLINK];
+    uint32_t _packets = _channel.packets[RADIO_UPLINK] + _channel.packets[RADIO_DOWNLINK];
+    
+    printf("{\"report\": \"%s\", \"window_ms\": %u, \"nodes\": %u, \"threads\": %u, \"sim_s\": %.1f, "
+           "\"wall_s\": %.3f, \"steps\": %u, \"steals\": %llu, "
+           "\"throughput\": {\"commands\": %u, \"frames\": %u, \"no_frame\": %u, \"commands_per_s\": %.2f, "
+           "\"frames_per_s\": %.2f, \"node_s_per_wall_s\": %.0f}, "
+           "\"latency_ms\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f}, "
+           "\"delivery_ms\": {\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}, "
+           "\"airtime\": {\"uplink_ms\": %.0f, \"downlink_ms\": %.0f, \"uplink_packets\": %u, "
+           "\"downlink_packets\": %u, \"utilization\": %.4f, \"mean_wait_ms\": %.2f, \"max_wait_ms\": %.1f}}\n",
+           _policy.report == PACKED_REPORT ? "packed" : "string", _policy.coalesceWindow, _nodes, _pool.size(),
+           _simS, _wallS, _steps, (unsigned long long)(_pool.steals() - _steals),
+           _handled, _frames, _noFrame, _handled / _simS, _frames / _simS, _simS * _nodes / _wallS,
+           percentileMs(_latency, 50), percentileMs(_latency, 90), percentileMs(_latency, 99),
+           percentileMs(_latency, 100),
+           percentileMs(_delivery, 50), percentileMs(_delivery, 99), percentileMs(_delivery, 100),
+           _channel.airUs[RADIO_UPLINK] / 1000.0, _channel.airUs[RADIO_DOWNLINK] / 1000.0,
+           _channel.packets[RADIO_UPLINK], _channel.packets[RADIO_DOWNLINK], _air / (double)_endUs,
+           _packets ? _channel.waitUs / 1000.0 / _packets : 0, _channel.longestWaitUs / 1000.0);
+    fflush(stdout);
+}
+
+static void usage(const char *_name)
+{
+    fprintf(stderr, "usage: %s [-t threads] [-n nodes] [-r packed,string] [-w ms,...] [-s settle_ms] trace\n"
+                    "       %s -g nodes minutes [seed]\n", _name, _name);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned _threads = std::thread::hardware_concurrency(), _nodes = 0, _settleMs = 10000;
+    std::vector<ReportPolicy> _reports;
+    std::vector<uint16_t> _windows;
+    std::vector<FleetCommand> _trace;
+    int i = 1;
+    
+    if (argc > 3 && !strcmp(argv[1], "-g"))
+    {
+        writeTrace(atoi(argv[2]), atoi(argv[3]), argc > 4 ? atoi(argv[4]) : 1);
+        return 0;
+    }
+    
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2)
+    {
+        char *_list = argv[i + 1];
+        
+        if (!strcmp(argv[i], "-t"))
+            _threads = atoi(_list);
+        else if (!strcmp(argv[i], "-n"))
+            _nodes = atoi(_list);
+        else if (!strcmp(argv[i], "-s"))
+            _settleMs = atoi(_list);
+        else if (!strcmp(argv[i], "-r"))
+        {
+            for (char *_item = strtok(_list, ","); _item; _item = strtok(NULL, ","))
+            {
+                if (strcmp(_item, "packed") && strcmp(_item, "string"))
+                    usage(argv[0]);
+                _reports.push_back(strcmp(_item, "packed") ? STRING_REPORT : PACKED_REPORT);
+            }
+        }
+        else if (!strcmp(argv[i], "-w"))
+        {
+            for (char *_item = strtok(_list, ","); _item; _item = strtok(NULL, ","))
+                _windows.push_back(atoi(_item));
+        }
+        else
+            usage(argv[0]);
+    }
+    if (i + 1 != argc || !readTrace(argv[i], _trace, _nodes))
+        usage(argv[0]);
+    if (_reports.empty())
+    {
+        _reports.push_back(PACKED_REPORT);
+        _reports.push_back(STRING_REPORT);
+    }
+    if (_windows.empty())
+    {
+        _windows.push_back(0);
+        _windows.push_back(300);
+    }
+    
+    WorkPool _pool(_threads);
+    uint64_t _endUs = (_trace.empty() ? 0 : _trace.back().issuedUs) + _settleMs * 1000ULL;
+    
+    for (size_t r = 0; r < _reports.size(); r++)
+    {
+        for (size_t w = 0; w < _windows.size(); w++)
+        {
+            FleetPolicy _policy = { _reports[r], _windows[w] };
+            
+            simulate(_trace, _nodes, _policy, _endUs, _pool);
+        }
+    }
+    
+    return 0;
+}
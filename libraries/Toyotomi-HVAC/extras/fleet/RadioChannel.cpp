@@ -0,0 +1,48 @@
+/*
+ * RadioChannel.cpp - Shared 802.15.4 channel of the fleet simulator
+ *
+ * Release into the public domain.
+*/
+
+#include "RadioChannel.h"
+
+// 0 - 7, fixed per packet
+static uint8_t backoffPeriods(const uint16_t _node, const uint32_t _seq)
+{
+    uint32_t _hash = (_node * 0x9E3779B1UL) ^ (_seq * 0x85EBCA77UL);
+    
+    _hash ^= _hash >> 15;
+    _hash *= 0x2C1B3C6DUL;
+    _hash ^= _hash >> 12;
+    
+    return _hash & 7;
+}
+
+RadioChannel::RadioChannel()
+{
+    this->airUs[RADIO_UPLINK] = this->airUs[RADIO_DOWNLINK] = 0;
+    this->packets[RADIO_UPLINK] = this->packets[RADIO_DOWNLINK] = 0;
+    this->waitUs = 0;
+    this->longestWaitUs = 0;
+    this->_busyUntil = 0;
+}
+
+// us when the packet queued at _at is off the air (and acknowledged)
+uint64_t RadioChannel::transmit(const uint64_t _at, const uint16_t _node, const uint32_t _seq,
+                                const uint8_t _payload, const bool _acked)
+{
+    uint8_t _link = _acked ? RADIO_DOWNLINK : RADIO_UPLINK;
+    uint64_t _start = _at > this->_busyUntil ? _at : this->_busyUntil;
+    uint32_t _air = (RADIO_OVERHEAD + _payload) * RADIO_BYTE_US + (_acked ? RADIO_ACK_US : 0);
+    
+    _start += backoffPeriods(_node, _seq) * RADIO_BACKOFF_US + RADIO_CCA_US;
+    this->_busyUntil = _start + _air;
+    
+    this->airUs[_link] += _air;
+    this->packets[_link]++;
+    this->waitUs += _start - _at;
+    if (_start - _at > this->longestWaitUs)
+        this->longestWaitUs = _start - _at;
+    
+    return this->_busyUntil;
+}
@@ -0,0 +1,59 @@
+/*
+ * RadioChannel.h - Shared 802.15.4 channel of the fleet simulator
+ *
+ * Stands in for the XBee modules and the air between them: one 250 kbit/s
+ * channel that every node and the coordinator share. A packet goes on air
+ * once the channel is free plus a CSMA backoff (0 - 7 backoff periods,
+ * drawn from the node and sequence number so runs repeat exactly, and a
+ * clear channel assessment). Collisions are not modelled: with the
+ * backoff on a free channel the loser would only back off again. The
+ * coordinator's commands are unicast and acknowledged, the nodes report to
+ * the broadcast address as the sketch does and get no acknowledgement.
+ *
+ * Packets have to be handed to transmit() in the order they were queued,
+ * the fleet simulator does this at the end of every step.
+ *
+ * Release into the public domain.
+*/
+
+#ifndef RADIO_CHANNEL_H
+#define RADIO_CHANNEL_H
+
+#include <stdint.h>
+
+#define RADIO_BYTE_US      32      // 250 kbit/s
+#define RADIO_OVERHEAD     17      // PHY header 6, MAC header 9 (16 bit addresses), FCS 2
+#define RADIO_ACK_US       (192 + 11 * RADIO_BYTE_US)  // turnaround and acknowledgement
+#define RADIO_BACKOFF_US   320
+#define RADIO_CCA_US       128
+#define RADIO_MAX_PAYLOAD  100     // XBee 802.15.4 limit
+
+#define UART_BAUD          38400   // node to XBee, as set by the sketch
+#define UART_FRAME         9       // API frame bytes around a Tx16 or Rx16 payload
+
+// us the UART takes for an API frame with _payload bytes
+static inline uint32_t uartUs(const uint8_t _payload)
+{
+    return (UART_FRAME + _payload) * 10 * 1000000UL / UART_BAUD;
+}
+
+class RadioChannel
+{
+    public:
+        RadioChannel(void);
+        uint64_t transmit(const uint64_t _at, const uint16_t _node, const uint32_t _seq,
+                          const uint8_t _payload, const bool _acked);
+        
+        uint64_t airUs[2];          // uplink, downlink
+        uint32_t packets[2];
+        uint64_t waitUs;            // queued to on air, every packet
+        uint64_t longestWaitUs;
+    
+    private:
+        uint64_t _busyUntil;
+};
+
+#define RADIO_UPLINK   0
+#define RADIO_DOWNLINK 1
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * WorkPool.h - Work-stealing thread pool of the fleet simulator
+ *
+ * run(count, fn) calls fn(i) for every i below count and returns when all
+ * calls are done. The range is cut into chunks that are dealt out to the
+ * workers' deques; a worker takes its own chunks from the back and, once
+ * it runs dry, steals from the front of the others. A node that is busy
+ * bit-banging a frame costs a thousand idle ones, so the chunks of a step
+ * are far from equal and the stealing is what keeps every core busy. The
+ * calling thread works as worker 0.
+ *
+ * Release into the public domain.
+*/
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define WORK_POOL_CHUNKS 8      // chunks per worker and run
+#define WORK_POOL_SPIN   4096   // polls before a worker sleeps
+
+class WorkPool
+{
+    public:
+        explicit WorkPool(unsigned _threads)
+            : _workers(_threads ? _threads : 1), _generation(0), _pending(0), _steals(0), _stop(false)
+        {
+            for (unsigned t = 1; t < this->_workers.size(); t++)
+                this->_threads.push_back(std::thread(&WorkPool::_worker, this, t));
+        }
+        
+        ~WorkPool()
+        {
+            {
+                std::lock_guard<std::mutex> _lock(this->_wakeLock);
+                this->_stop = true;
+                this->_generation++;
+            }
+            this->_wake.notify_all();
+            for (size_t t = 0; t < this->_threads.size(); t++)
+                this->_threads[t].join();
+        }
+        
+        void run(const size_t _count, const std::function<void(size_t)> &_fn)
+        {
+            size_t _chunks = this->_workers.size() * WORK_POOL_CHUNKS;
+            size_t _size = (_count + _chunks - 1) / _chunks;
+            
+            if (!_count)
+                return;
+            
+            this->_fn = &_fn;
+            for (size_t _first = 0, w = 0; _first < _count; _first += _size, w++)
+            {
+                Worker &_worker = this->_workers[w % this->_workers.size()];
+                Chunk _chunk = { _first, _first + _size < _count ? _first + _size : _count };
+                
+                std::lock_guard<std::mutex> _lock(_worker.lock);
+                _worker.chunks.push_back(_chunk);
+                this->_pending++;
+            }
+            {
+                std::lock_guard<std::mutex> _lock(this->_wakeLock);
+                this->_generation++;
+            }
+            this->_wake.notify_all();
+            
+            this->_work(0);
+            while (this->_pending.load(std::memory_order_acquire))
+                std::this_thread::yield();
+        }
+        
+        unsigned size(void)
+        {
+            return this->_workers.size();
+        }
+        
+        // chunks run by another worker than the one they were dealt to
+        uint64_t steals(void)
+        {
+            return this->_steals;
+        }
+    
+    private:
+        struct Chunk
+        {
+            size_t first;
+            size_t last;
+        };
+        
+        struct Worker
+        {
+            std::mutex lock;
+            std::deque<Chunk> chunks;
+        };
+        
+        bool _take(const unsigned _self, Chunk &_chunk)
+        {
+            Worker &_own = this->_workers[_self];
+            
+            {
+                std::lock_guard<std::mutex> _lock(_own.lock);
+                if (!_own.chunks.empty())
+                {
+                    _chunk = _own.chunks.back();
+                    _own.chunks.pop_back();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < this->_workers.size(); i++)
+            {
+                Worker &_victim = this->_workers[(_self + i) % this->_workers.size()];
+                
+                std::lock_guard<std::mutex> _lock(_victim.lock);
+                if (!_victim.chunks.empty())
+                {
+                    _chunk = _victim.chunks.front();
+                    _victim.chunks.pop_front();
+                    this->_steals++;
+                    return true;
+                }
+            }
+            
+            return false;
+        }
+        
+        void _work(const unsigned _self)
+        {
+            Chunk _chunk;
+            
+            while (this->_take(_self, _chunk))
+            {
+                for (size_t i = _chunk.first; i < _chunk.last; i++)
+                    (*this->_fn)(i);
+                this->_pending.fetch_sub(1, std::memory_order_release);
+            }
+        }
+        
+        void _worker(const unsigned _self)
+        {
+            uint64_t _seen = 0;
+            
+            for (;;)
+            {
+                for (unsigned n = 0; n < WORK_POOL_SPIN && this->_generation.load() == _seen; n++)
+                    std::this_thread::yield();
+                {
+                    std::unique_lock<std::mutex> _lock(this->_wakeLock);
+                    while (this->_generation.load() == _seen)
+                        this->_wake.wait(_lock);
+                    _seen = this->_generation.load();
+                    if (this->_stop)
+                        return;
+                }
+                this->_work(_self);
+            }
+        }
+        
+        std::vector<Worker> _workers;
+        std::vector<std::thread> _threads;
+        const std::function<void(size_t)> *_fn;
+        std::mutex _wakeLock;
+        std::condition_variable _wake;
+        std::atomic<uint64_t> _generation;
+        std::atomic<size_t> _pending;       // chunks not finished yet
+        std::atomic<uint64_t> _steals;
+        bool _stop;
+};
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * AvrRegisters.cpp - Storage for the host-side AVR registers
+ * 
+ * Release into the public domain.
+*/
+
+#include <avr/io.h>
+
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint16_t TCNT1;
+volatile uint16_t OCR1A;
+volatile uint8_t TIMSK1;
+volatile uint8_t TIFR1;
+
+volatile uint8_t TCCR2A;
+volatile uint8_t TCCR2B;
+volatile uint8_t TCNT2;
+volatile uint8_t OCR2A;
+volatile uint8_t OCR2B;
@@ -0,0 +1,123 @@
+/*
+ * BatchTest.cpp - beginUpdate(), commit() and Toyotomi::Batch
+ *
+ * A batch sends nothing until its commit, then the state it ended with
+ * and after it the toggles and air direction steps made in it. A commit
+ * that leaves the unit as it was sends nothing, nested batches send with
+ * the outermost commit, and a batch that ends with the unit off sends
+ * only the power off and the LED display toggle, taking the other
+ * toggles back.
+ *
+ * Release into the public domain.
+*/
+
+#include <Toyotomi.h>
+#include <MockHal.h>
+#include "HostTest.h"
+#include "TraceFrames.h"
+
+static void checkOrder(void)
+{
+    Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    uint16_t _before;
+    bool _sent;
+    
+    CHECK_SENDS(_unit, _unit.forceResend(), "state");
+    
+    _before = _unit.getFramesSent();
+    _unit.beginUpdate();
+    _unit.buttonSwing();
+    _unit.setTemperature(22);
+    _unit.buttonAirDirection();
+    _unit.buttonTurbo();
+    _unit.buttonAirDirection();
+    HOST_CHECK(_unit.getFramesSent() == _before, "%u frames sent inside the batch",
+               _unit.getFramesSent() - _before);
+    CHECK_SENDS(_unit, _sent = _unit.commit(), "state swing turbo air air");
+    HOST_CHECK(_sent, "commit() returns false");
+    HOST_CHECK(_unit.isSwingOn() && _unit.isTurboOn(), "toggles of the batch lost");
+    
+    // toggles only, the state is the one the unit has
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.buttonCleanAir(), _unit.commit()), "cleanair");
+    
+    // a toggle made twice is no toggle
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.buttonSwing(), _unit.buttonSwing(), _unit.commit()), "");
+    HOST_CHECK(_unit.isSwingOn(), "swing toggled twice is off");
+}
+
+static void checkNoOp(void)
+{
+    Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    bool _sent;
+    
+    CHECK_SENDS(_unit, _unit.forceResend(), "state");
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.setTemperature(26), _unit.setTemperature(24),
+                        _sent = _unit.commit()), "");
+    HOST_CHECK(!_sent, "commit() of no change returns true");
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.setMode(HEAT), _unit.setMode(COOL), _unit.commit()), "");
+    CHECK_SENDS(_unit, _sent = _unit.commit(), "");
+    HOST_CHECK(!_sent, "commit() without beginUpdate() returns true");
+    
+    // off before and after
+    CHECK_SENDS(_unit, _unit.powerOff(), "off");
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.setTemperature(20), _unit.buttonSwing(), _unit.commit()), "");
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.powerOn(), _unit.setTemperature(23), _unit.commit()), "state");
+    HOST_CHECK(_unit.getTemperature() == 23, "temperature %u after the batch", _unit.getTemperature());
+}
+
+static void checkNesting(void)
+{
+    Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    bool _sent;
+    
+    CHECK_SENDS(_unit, _unit.forceResend(), "state");
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.beginUpdate(), _unit.setTemperature(21), _sent = _unit.commit()),
+                "");
+    HOST_CHECK(!_sent, "inner commit() returns true");
+    CHECK_SENDS(_unit, (_unit.buttonLedDisplay(), _unit.commit()), "state led");
+    
+    {
+        uint16_t _before = _unit.getFramesSent();
+        
+        {
+            Toyotomi::Batch _batch(_unit);
+            
+            _unit.setMode(HEAT);
+            _unit.buttonTurbo();
+            HOST_CHECK(_unit.getFramesSent() == _before, "Batch sent before its end");
+        }
+        HOST_CHECK(frameTypes(traceFrames(_unit, _before)) == "state turbo", "Batch sent \"%s\"",
+                   frameTypes(traceFrames(_unit, _before)).c_str());
+    }
+}
+
+static void checkEndingOff(void)
+{
+    Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    
+    CHECK_SENDS(_unit, _unit.forceResend(), "state");
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.buttonSwing(), _unit.buttonTurbo(), _unit.buttonCleanAir(),
+                        _unit.buttonLedDisplay(), _unit.buttonAirDirection(), _unit.powerOff(), _unit.commit()),
+                "off led");
+    HOST_CHECK(!_unit.isPoweredOn(), "on after the batch");
+    HOST_CHECK(!_unit.isSwingOn() && !_unit.isTurboOn() && !_unit.isCleanAirOn(),
+               "toggles of a unit that ended off kept: swing %d, turbo %d, clean air %d", _unit.isSwingOn(),
+               _unit.isTurboOn(), _unit.isCleanAirOn());
+    HOST_CHECK(!_unit.isLedDisplayOn(), "LED display toggle of a unit that ended off lost");
+    
+    // the held air direction steps are dropped, not sent with the next state
+    CHECK_SENDS(_unit, _unit.powerOn(), "state");
+}
+
+int main()
+{
+    mockHalReset();
+    mockHalKeepEdges(false);
+    
+    checkOrder();
+    checkNoOp();
+    checkNesting();
+    checkEndingOff();
+    
+    return hostTestResult("BatchTest");
+}
@@ -0,0 +1,168 @@
+/*
+ * CarrierTest.cpp - Frequency, duty cycle and marks of the IR carrier
+ *
+ * Sends one power on frame and measures what reaches the LED. The software
+ * carrier is checked from the recorded pin edges of Toyotomi (digitalWrite),
+ * ToyotomiPin (sbi/cbi) and ToyotomiGroup (port mask) with the bench's
+ * waveform analysis; the Timer2 carrier from the registers as the
+ * ATmega328P would decode them, and from the gating edges on OC2A. The
+ * carrier has to be within IR_CLOCK_TOLERANCE of IR_CLOCK_RATE and square,
+ * and every mark within the same tolerance of its length.
+ *
+ * Release into the public domain.
+*/
+
+#include <math.h>
+#include <Toyotomi.h>
+#include <ToyotomiPin.h>
+#include <ToyotomiGroup.h>
+#include <MockHal.h>
+#include <Timer2Mock.h>
+#include "Waveform.h"
+#include "HostTest.h"
+
+#define FRAME_MARKS      (2 * ToyotomiProtocol::symbols)    // powerOn() repeats its frame
+#define DUTY_TOLERANCE   0.02
+
+static bool withinTolerance(const double _measured, const double _nominal)
+{
+    return fabs(_measured - _nominal) * 100 <= IR_CLOCK_TOLERANCE * _nominal;
+}
+
+#ifndef IR_TIMER2_CARRIER
+
+static void checkPin(const char *_name, const uint8_t _pin, const uint64_t _begin)
+{
+    const std::vector<MockEdge> &_mock = mockHalEdges();
+    std::vector<WaveEdge> _edges;
+    WaveReport _report;
+    
+    for (size_t i = 0; i < _mock.size(); i++)
+    {
+        WaveEdge _edge = { _mock[i].cycle, _mock[i].level };
+        
+        if (_mock[i].pin == _pin)
+            _edges.push_back(_edge);
+    }
+    analyseWaveform(_edges, F_CPU, _begin, mockHalCycles() + 1, _report);
+    
+    HOST_CHECK(carrierInTolerance(_report), "%s: carrier at %.1f Hz", _name, _report.carrierHz);
+    HOST_CHECK(fabs(_report.duty - 0.5) <= DUTY_TOLERANCE, "%s: duty cycle %.3f", _name, _report.duty);
+    HOST_CHECK(_report.marks == FRAME_MARKS, "%s: %u marks", _name, _report.marks);
+    for (unsigned i = HEADER_MARK; i <= BIT_MARK; i += BIT_MARK - HEADER_MARK)
+    {
+        const SymbolStats &_mark = _report.symbols[i];
+        
+        HOST_CHECK(_mark.count && withinTolerance(_mark.min, _mark.nominal) &&
+                   withinTolerance(_mark.max, _mark.nominal),
+                   "%s: marks of %.0f us last %.1f - %.1f us", _name, _mark.nominal, _mark.min, _mark.max);
+    }
+}
+
+static void checkSoftware(void)
+{
+    uint64_t _begin;
+    
+    mockHalReset();
+    Toyotomi _digital;
+    ToyotomiPin<9> _port;
+    ToyotomiPin<10> _first;
+    ToyotomiPin<11> _second;
+    ToyotomiGroup _group;
+    
+    _begin = mockHalCycles();
+    _digital.powerOn();
+    checkPin("Toyotomi", DEFAULT_LED_PIN, _begin);
+    
+    mockHalClearEdges();
+    _begin = mockHalCycles();
+    _port.powerOn();
+    checkPin("ToyotomiPin", 9, _begin);
+    
+    _group.add(_first);
+    _group.add(_second);
+    mockHalClearEdges();
+    _begin = mockHalCycles();
+    _group.begin();
+    _first.powerOn();
+    _second.powerOn();
+    _group.send();
+    checkPin("ToyotomiGroup pin 10", 10, _begin);
+    checkPin("ToyotomiGroup pin 11", 11, _begin);
+    
+    // a member moved after it joined is played on its new pin
+    _second.setIRLEDPin(12);
+    mockHalClearEdges();
+    _begin = mockHalCycles();
+    _group.begin();
+    _first.forceResend();
+    _second.forceResend();
+    _group.send();
+    checkPin("ToyotomiGroup pin 10", 10, _begin);
+    checkPin("ToyotomiGroup moved to pin 12", 12, _begin);
+    for (size_t i = 0; i < mockHalEdges().size(); i++)
+        HOST_CHECK(mockHalEdges()[i].pin != 11, "ToyotomiGroup still drives pin 11");
+}
+
+#else
+
+static void waitIdle(Toyotomi &_unit)
+{
+    while (_unit.isTransmitting())
+        Toyotomi::idle();
+}
+
+static void checkTimer2(void)
+{
+    const std::vector<MockEdge> &_edges = mockHalEdges();
+    const double _unitCycles = IR_UNIT_CYCLES;
+    unsigned _marks = 0;
+    
+    mockHalReset();
+    Toyotomi _unit;
+    
+    _unit.powerOn();
+    waitIdle(_unit);
+    
+    HOST_CHECK(mockHalPinIsOutput(IR_TIMER2_PIN), "OC2A is not an output");
+    HOST_CHECK(withinTolerance(timer2ConfiguredHz(F_CPU), IR_CLOCK_RATE), "Timer2 set up for %.1f Hz",
+               timer2ConfiguredHz(F_CPU));
+    HOST_CHECK(!timer2CarrierEnabled(), "carrier left on after the frame");
+    
+    for (size_t i = 0; i < _edges.size(); i++)
+    {
+        double _units;
+        
+        if (!_edges[i].carrier)
+            continue;
+        HOST_CHECK(i + 1 < _edges.size() && !_edges[i + 1].carrier, "carrier mark %u not gated off", _marks);
+        if (i + 1 == _edges.size())
+            break;
+        
+        _units = (_edges[i + 1].cycle - _edges[i].cycle) / _unitCycles;
+        HOST_CHECK(withinTolerance(_units, ToyotomiProtocol::mark(_marks % ToyotomiProtocol::symbols)),
+                   "mark %u lasts %.2f units", _marks, _units);
+        _marks++;
+    }
+    HOST_CHECK(_marks == FRAME_MARKS, "%u marks", _marks);
+    
+    halCarrierOn();
+    HOST_CHECK(timer2CarrierEnabled(), "halCarrierOn() leaves OC2A disconnected");
+    HOST_CHECK(withinTolerance(timer2CarrierHz(F_CPU), IR_CLOCK_RATE), "carrier at %.1f Hz", timer2CarrierHz(F_CPU));
+    HOST_CHECK(fabs(timer2CarrierDuty() - 0.5) <= DUTY_TOLERANCE, "duty cycle %.3f", timer2CarrierDuty());
+    halCarrierOff();
+    HOST_CHECK(!timer2CarrierEnabled(), "halCarrierOff() leaves OC2A connected");
+}
+
+#endif
+
+int main()
+{
+#ifdef IR_TIMER2_CARRIER
+    checkTimer2();
+#else
+    checkSoftware();
+#endif
+
+    return hostTestResult("CarrierTest");
+}
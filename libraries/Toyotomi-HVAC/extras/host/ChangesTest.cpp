@@ -0,0 +1,137 @@
+/*
+ * ChangesTest.cpp - takeChanges() against the reported state
+ *
+ * The state report sends the fields takeChanges() names and the gateway
+ * keeps the rest, so the mask has to name every PackedState field that
+ * reads differently after a call. A field set and set back within one
+ * batch may be named as well. A mode switch names exactly the fields it
+ * changes; every mode is switched to from every other one, since FAN
+ * hides the temperature and AUTO and DRY the fan speed. Then the other
+ * setters and toggles are run through.
+ *
+ * Release into the public domain.
+*/
+
+#include <Toyotomi.h>
+#include <MockHal.h>
+#include "HostTest.h"
+
+static const char *modeNames[] = { "AUTO", "COOL", "DRY", "HEAT", "FAN" };
+
+// CHANGED_* bits of the packed fields that differ
+static uint16_t packedChanges(const PackedState &_before, const PackedState &_after)
+{
+    uint8_t _flags = _before.flags ^ _after.flags;
+    uint8_t _features = _before.features ^ _after.features;
+    
+    return (_flags & PACKED_ACTIVE ? CHANGED_ACTIVE : 0) |
+           (_flags & PACKED_SLEEP ? CHANGED_SLEEP : 0) |
+           (_flags & PACKED_MODE ? CHANGED_MODE : 0) |
+           (_flags & PACKED_FANSPEED ? CHANGED_FANSPEED : 0) |
+           (_before.temperature != _after.temperature ? CHANGED_TEMP : 0) |
+           (_before.timerOn != _after.timerOn ? CHANGED_TIMERON : 0) |
+           (_before.timerOff != _after.timerOff ? CHANGED_TIMEROFF : 0) |
+           (_features & PACKED_SWING ? CHANGED_SWING : 0) |
+           (_features & PACKED_TURBO ? CHANGED_TURBO : 0) |
+           (_features & PACKED_CLEANAIR ? CHANGED_CLEANAIR : 0) |
+           (_features & PACKED_LEDDISP ? CHANGED_LEDDISP : 0);
+}
+
+static void checkPacked(Toyotomi &_unit, const char *_after)
+{
+    PackedState _state = _unit.getPackedState();
+    
+    HOST_CHECK(_state.temperature == _unit.getTemperature(), "%s: packed temperature %u, getter %u", _after,
+               _state.temperature, _unit.getTemperature());
+    HOST_CHECK((_state.flags & PACKED_FANSPEED) == _unit.getFanSpeed(), "%s: packed fan speed %u, getter %u",
+               _after, _state.flags & PACKED_FANSPEED, _unit.getFanSpeed());
+    HOST_CHECK((_state.flags & PACKED_MODE) >> PACKED_MODE_SHIFT == _unit.getMode(), "%s: packed mode %u",
+               _after, (_state.flags & PACKED_MODE) >> PACKED_MODE_SHIFT);
+}
+
+#define CHECK_CHANGES(_unit, _call) \
+    do \
+    { \
+        PackedState _before = (_unit).getPackedState(); \
+        uint16_t _changes; \
+        \
+        (_unit).takeChanges(); \
+        _call; \
+        _changes = (_unit).takeChanges(); \
+        HOST_CHECK(!(packedChanges(_before, (_unit).getPackedState()) & ~_changes), \
+                   "%s: changes 0x%03X, packed fields 0x%03X", #_call, _changes, \
+                   packedChanges(_before, (_unit).getPackedState())); \
+        checkPacked(_unit, #_call); \
+    } while (0)
+
+static void checkModes(void)
+{
+    for (int _from = AUTO; _from <= FAN; _from++)
+    {
+        for (int _to = AUTO; _to <= FAN; _to++)
+        {
+            Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+            PackedState _before;
+            uint16_t _changes;
+            
+            _unit.setMode((Mode)_from);
+            _unit.takeChanges();
+            _before = _unit.getPackedState();
+            _unit.setMode((Mode)_to);
+            _changes = _unit.takeChanges();
+            
+            HOST_CHECK(_changes == packedChanges(_before, _unit.getPackedState()),
+                       "%s to %s: changes 0x%03X, packed fields 0x%03X", modeNames[_from], modeNames[_to],
+                       _changes, packedChanges(_before, _unit.getPackedState()));
+            HOST_CHECK(!(_changes & CHANGED_TEMP) == ((_from == FAN) == (_to == FAN)),
+                       "%s to %s: CHANGED_TEMP 0x%03X", modeNames[_from], modeNames[_to], _changes);
+            checkPacked(_unit, modeNames[_to]);
+        }
+    }
+}
+
+static void checkSetters(void)
+{
+    Toyotomi _unit;
+    
+    HOST_CHECK(_unit.takeChanges() == CHANGED_ALL, "a new unit does not report everything");
+    HOST_CHECK(_unit.takeChanges() == 0, "takeChanges() does not clear the mask");
+    
+    CHECK_CHANGES(_unit, _unit.powerOn());
+    CHECK_CHANGES(_unit, _unit.setMode(COOL));
+    HOST_CHECK(_unit.getFanSpeed() == DEFAULT_SP, "AUTO to COOL gives fan speed %u", _unit.getFanSpeed());
+    CHECK_CHANGES(_unit, _unit.setTemperature(26));
+    CHECK_CHANGES(_unit, _unit.setTemperature(26));
+    CHECK_CHANGES(_unit, _unit.setFanSpeed(MED_SP));
+    CHECK_CHANGES(_unit, _unit.setMode(FAN));
+    CHECK_CHANGES(_unit, _unit.setTemperature(20));
+    CHECK_CHANGES(_unit, _unit.setState(28, FAN, LOW_SP));
+    CHECK_CHANGES(_unit, _unit.setState(28, DRY, HIGH_SP));
+    CHECK_CHANGES(_unit, _unit.setFanSpeed(LOW_SP));
+    CHECK_CHANGES(_unit, _unit.buttonMode());
+    CHECK_CHANGES(_unit, _unit.buttonFanSpeed());
+    CHECK_CHANGES(_unit, _unit.buttonTempDown());
+    CHECK_CHANGES(_unit, _unit.setTimerOff(HOUR030));
+    CHECK_CHANGES(_unit, _unit.setTimerOn(HOUR030));
+    CHECK_CHANGES(_unit, _unit.buttonTimerOn());
+    CHECK_CHANGES(_unit, _unit.buttonSwing());
+    CHECK_CHANGES(_unit, _unit.setTurbo(true));
+    CHECK_CHANGES(_unit, _unit.setCleanAir(true));
+    CHECK_CHANGES(_unit, _unit.setLedDisplay(false));
+    CHECK_CHANGES(_unit, _unit.buttonAirDirection());
+    CHECK_CHANGES(_unit, _unit.powerOff());
+    CHECK_CHANGES(_unit, _unit.setMode(AUTO));
+    CHECK_CHANGES(_unit, _unit.buttonOnOff());
+    CHECK_CHANGES(_unit, (_unit.beginUpdate(), _unit.setMode(FAN), _unit.setMode(HEAT), _unit.commit()));
+}
+
+int main()
+{
+    mockHalReset();
+    mockHalKeepEdges(false);
+    
+    checkModes();
+    checkSetters();
+    
+    return hostTestResult("ChangesTest");
+}
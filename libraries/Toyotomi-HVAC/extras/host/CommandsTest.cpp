@@ -0,0 +1,182 @@
+/*
+ * CommandsTest.cpp - ToyotomiCommands, as the sketch and the fleet run it
+ *
+ * Toyotomi.ino and FleetNode hand their radio commands to the same
+ * ToyotomiCommands. A command sequence is fed to it and every command's
+ * frames are compared with those of a second unit driven through the
+ * library calls the command stands for, window included: set-commands
+ * open it, toggles, resends and power off send it first. The host calls
+ * are counted, and both state reports are checked against the unit.
+ *
+ * Release into the public domain.
+*/
+
+#include <string>
+#include <vector>
+#include <Toyotomi.h>
+#include <ToyotomiCommands.h>
+#include <MockHal.h>
+#include "HostTest.h"
+#include "TraceFrames.h"
+
+#define WINDOW_MS 300
+
+struct TestHost
+{
+    TestHost() : windows(0), started(0), windowed(0), done(0), closing(0), closed(0), stats(0), statsCommand(0xFF),
+                 traces(0), packed(0), changes(0)
+    {
+    }
+    
+    void scheduleCommit(uint16_t _ms)
+    {
+        HOST_CHECK(_ms == WINDOW_MS, "window scheduled for %u ms", _ms);
+        this->windows++;
+    }
+    void commandStarting(uint8_t) { this->started++; }
+    void commandDone(bool _windowed) { _windowed ? this->windowed++ : this->done++; }
+    void windowClosing(void) { this->closing++; }
+    void windowClosed(void) { this->closed++; }
+    void sendStats(uint8_t _command) { this->stats++; this->statsCommand = _command; }
+    void sendTrace(void) { this->traces++; }
+    void sendPackedState(uint16_t _changes, const PackedState &_state)
+    {
+        this->packed++;
+        this->changes = _changes;
+        this->state = _state;
+    }
+    void sendValue(const char *_name, int _value)
+    {
+        this->values.push_back(std::string(_name) + "=" + std::to_string(_value));
+    }
+    
+    unsigned windows, started, windowed, done, closing, closed, stats, statsCommand, traces, packed;
+    uint16_t changes;
+    PackedState state;
+    std::vector<std::string> values;
+};
+
+static void send(ToyotomiCommands<TestHost> &_commands, const uint8_t _command, const uint8_t _a = 0,
+                 const uint8_t _b = 0, const uint8_t _c = 0)
+{
+    const uint8_t _packet[COMMAND_LEN] = { 1, _command, _a, _b, _c };
+    
+    _commands.handle(_packet);
+}
+
+// the frames of _call against those of _calls on _reference
+#define CHECK_FRAMES(_call, _calls) \
+    do \
+    { \
+        uint16_t _before = _unit.getFramesSent(); \
+        std::vector<TracedFrame> _sent; \
+        \
+        _call; \
+        _sent = traceFrames(_unit, _before); \
+        _before = _reference.getFramesSent(); \
+        _calls; \
+        HOST_CHECK(sameFrames(_sent, traceFrames(_reference, _before)), "%s: %u frames, not those of %s", \
+                   #_call, (unsigned)_sent.size(), #_calls); \
+    } while (0)
+
+static void checkWindow(void)
+{
+    Toyotomi _unit, _reference;
+    TestHost _host;
+    ToyotomiCommands<TestHost> _commands(_unit, _host, WINDOW_MS);
+    uint16_t _before;
+    
+    CHECK_FRAMES(send(_commands, 6), _reference.powerOn());
+    CHECK_FRAMES(send(_commands, 1, 24), (_reference.beginUpdate(), _reference.setTemperature(24)));
+    HOST_CHECK(_commands.isCoalescing(), "a set-command does not open the window");
+    CHECK_FRAMES(send(_commands, 2, COOL), _reference.setMode(COOL));
+    CHECK_FRAMES(send(_commands, 3, HIGH_SP), _reference.setFanSpeed(HIGH_SP));
+    
+    // the resend sends the window, then the same frame again
+    _before = _unit.getFramesSent();
+    CHECK_FRAMES(send(_commands, 15), (_reference.commit(), _reference.forceResend()));
+    HOST_CHECK(_unit.getFramesSent() - _before == 2, "resend in the window sent %u frames",
+               _unit.getFramesSent() - _before);
+    HOST_CHECK(!_commands.isCoalescing(), "the resend leaves the window open");
+    
+    CHECK_FRAMES(send(_commands, 1, 20), (_reference.beginUpdate(), _reference.setTemperature(20)));
+    CHECK_FRAMES(send(_commands, 8), (_reference.commit(), _reference.buttonSwing()));
+    CHECK_FRAMES(send(_commands, 14, 22, HEAT, LOW_SP), _reference.setState(22, HEAT, LOW_SP));
+    CHECK_FRAMES(send(_commands, 16, 1), _reference.setSwing(true));
+    CHECK_FRAMES(send(_commands, 19, 1), _reference.setTurbo(true));
+    CHECK_FRAMES(send(_commands, 4, HOUR010), (_reference.beginUpdate(), _reference.setTimerOn(HOUR010)));
+    CHECK_FRAMES(send(_commands, 1, 26), _reference.setTemperature(26));
+    
+    // the coalesce task
+    CHECK_FRAMES(_commands.closeWindow(), _reference.commit());
+    CHECK_FRAMES(_commands.closeWindow(), (void)0);
+    
+    CHECK_FRAMES(send(_commands, 1, 18), (_reference.beginUpdate(), _reference.setTemperature(18)));
+    CHECK_FRAMES(send(_commands, 7), (_reference.powerOff(), _reference.commit()));
+    CHECK_FRAMES(send(_commands, 20, 0), (void)0);
+    CHECK_FRAMES(send(_commands, 21), (void)0);
+    
+    HOST_CHECK(_host.windows == 4 && _host.closing == 4 && _host.closed == 4, "%u windows, %u closing, %u closed",
+               _host.windows, _host.closing, _host.closed);
+    HOST_CHECK(_host.started == 16, "%u commands started", _host.started);
+    HOST_CHECK(_host.windowed == 7 && _host.done == 7, "%u commands windowed, %u not", _host.windowed, _host.done);
+    HOST_CHECK(_host.stats == 1 && _host.statsCommand == 0 && _host.traces == 1, "%u stats (%u), %u traces",
+               _host.stats, _host.statsCommand, _host.traces);
+}
+
+static void checkNoWindow(void)
+{
+    Toyotomi _unit, _reference;
+    TestHost _host;
+    ToyotomiCommands<TestHost> _commands(_unit, _host, 0);
+    
+    CHECK_FRAMES(send(_commands, 6), _reference.powerOn());
+    CHECK_FRAMES(send(_commands, 1, 24), _reference.setTemperature(24));
+    CHECK_FRAMES(send(_commands, 2, HEAT), _reference.setMode(HEAT));
+    CHECK_FRAMES(send(_commands, 15), _reference.forceResend());
+    HOST_CHECK(!_commands.isCoalescing() && !_host.windows, "window opened with a window of 0 ms");
+    HOST_CHECK(_host.windowed == 0 && _host.done == 4, "%u commands windowed, %u not", _host.windowed, _host.done);
+}
+
+static void checkReports(void)
+{
+    Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    TestHost _packedHost, _textHost;
+    ToyotomiCommands<TestHost> _packed(_unit, _packedHost, WINDOW_MS);
+    ToyotomiCommands<TestHost> _text(_unit, _textHost, WINDOW_MS, true);
+    PackedState _state;
+    
+    _text.sendState();
+    HOST_CHECK(_textHost.values.size() == 11 && _textHost.values[0] == "ac_active=1" &&
+               _textHost.values[1] == "ac_temp=24" && _textHost.values[2] == "ac_mode=1",
+               "text report of a new unit: %u values, first %s", (unsigned)_textHost.values.size(),
+               _textHost.values.empty() ? "none" : _textHost.values[0].c_str());
+    HOST_CHECK(!_textHost.packed, "text report sent a PackedState");
+    
+    _textHost.values.clear();
+    _text.sendState();
+    HOST_CHECK(_textHost.values.empty(), "text report repeated %u values", (unsigned)_textHost.values.size());
+    
+    send(_packed, 1, 20);
+    _packed.closeWindow();
+    _packed.sendState();
+    _state = _unit.getPackedState();
+    HOST_CHECK(_packedHost.packed == 1 && _packedHost.changes == CHANGED_TEMP &&
+               !memcmp(&_packedHost.state, &_state, sizeof(_state)), "%u packed reports, changes 0x%03X",
+               _packedHost.packed, _packedHost.changes);
+    HOST_CHECK(_packedHost.values.empty(), "packed report sent text values");
+    _packed.sendState();
+    HOST_CHECK(_packedHost.packed == 1, "packed report repeated");
+}
+
+int main()
+{
+    mockHalReset();
+    mockHalKeepEdges(false);
+    
+    checkWindow();
+    checkNoWindow();
+    checkReports();
+    
+    return hostTestResult("CommandsTest");
+}
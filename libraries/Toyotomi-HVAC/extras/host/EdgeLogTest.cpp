@@ -0,0 +1,162 @@
+/*
+ * EdgeLogTest.cpp - Recorded pin edges against a golden log
+ *
+ * Usage: edgelogtest [-u] <golden.edges>
+ *
+ * Runs the benchmark command sequence on Toyotomi and ToyotomiPin, two
+ * grouped units and a batch, and logs one line per command: the number
+ * of edges the mock recorded, the cycles until the command returned and
+ * an FNV-1a hash of the edges (cycle relative to the command start, pin,
+ * level, carrier flag). Any change to what reaches the LED, or when,
+ * shows up as a changed line. With -u the log is written instead of
+ * compared; "make golden" does that for every variant.
+ *
+ * Release into the public domain.
+*/
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <Toyotomi.h>
+#include <ToyotomiPin.h>
+#include <ToyotomiGroup.h>
+#include <MockHal.h>
+#include "BenchCommands.h"
+#include "HostTest.h"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME  1099511628211ULL
+
+#define EDGE_LOG(_name, _call) \
+    _begin = mockHalCycles(); \
+    mockHalClearEdges(); \
+    _call; \
+    while (_unit.isTransmitting()) \
+        Toyotomi::idle(); \
+    logEdges(_log, _section, #_name, _begin);
+
+static uint64_t hashBytes(uint64_t _hash, const void *_data, const size_t _length)
+{
+    const uint8_t *_bytes = (const uint8_t *)_data;
+    
+    for (size_t i = 0; i < _length; i++)
+        _hash = (_hash ^ _bytes[i]) * FNV_PRIME;
+    
+    return _hash;
+}
+
+static void logEdges(std::vector<std::string> &_log, const char *_section, const char *_name,
+                     const uint64_t _begin)
+{
+    const std::vector<MockEdge> &_edges = mockHalEdges();
+    uint64_t _hash = FNV_OFFSET;
+    char _line[96];
+    
+    for (size_t i = 0; i < _edges.size(); i++)
+    {
+        uint64_t _cycle = _edges[i].cycle - _begin;
+        uint8_t _bits[3] = { _edges[i].pin, _edges[i].level, _edges[i].carrier };
+        
+        _hash = hashBytes(_hash, &_cycle, sizeof(_cycle));
+        _hash = hashBytes(_hash, _bits, sizeof(_bits));
+    }
+    snprintf(_line, sizeof(_line), "%s %s %u %llu %016llx", _section, _name, (unsigned)_edges.size(),
+             (unsigned long long)(mockHalCycles() - _begin), (unsigned long long)_hash);
+    _log.push_back(_line);
+}
+
+static void logUnit(std::vector<std::string> &_log, const char *_section, Toyotomi &_unit)
+{
+    uint64_t _begin;
+    
+    BENCH_COMMANDS(EDGE_LOG, _unit)
+}
+
+static void logGroup(std::vector<std::string> &_log)
+{
+    const char *_section = "group";
+    uint64_t _begin;
+    ToyotomiPin<9> _first;
+    ToyotomiPin<10> _second(22, HEAT, LOW_SP, HOUR000, HOUR000, true);
+    ToyotomiGroup _group;
+    Toyotomi &_unit = _first;          // the queue is shared, any unit tells
+    
+    _group.add(_first);
+    _group.add(_second);
+    EDGE_LOG(powerOn, (_group.begin(), _first.powerOn(), _second.setMode(COOL), _group.send()))
+    EDGE_LOG(setState, (_group.begin(), _first.setState(20, DRY, MED_SP), _second.buttonTurbo(), _group.send()))
+    EDGE_LOG(powerOff, (_group.begin(), _first.powerOff(), _second.powerOff(), _group.send()))
+    
+    _section = "batch";
+    EDGE_LOG(powerOn, (_first.beginUpdate(), _first.powerOn(), _first.buttonSwing(), _first.buttonAirDirection(),
+                       _first.commit()))
+    EDGE_LOG(powerOff, (_first.beginUpdate(), _first.buttonTurbo(), _first.powerOff(), _first.buttonLedDisplay(),
+                        _first.commit()))
+}
+
+static bool readLog(const char *_path, std::vector<std::string> &_log)
+{
+    FILE *_in = fopen(_path, "r");
+    char _line[128];
+    
+    if (!_in)
+        return false;
+    while (fgets(_line, sizeof(_line), _in))
+    {
+        _line[strcspn(_line, "\r\n")] = 0;
+        _log.push_back(_line);
+    }
+    fclose(_in);
+    
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> _log, _golden;
+    bool _update = argc == 3 && !strcmp(argv[1], "-u");
+    const char *_path = argv[argc - 1];
+    
+    if (argc != 2 && !_update)
+    {
+        fprintf(stderr, "usage: %s [-u] <golden.edges>\n", argv[0]);
+        return 2;
+    }
+    
+    mockHalReset();
+    {
+        Toyotomi _digital;
+        ToyotomiPin<9> _port;
+        
+        logUnit(_log, "toyotomi", _digital);
+        logUnit(_log, "pin", _port);
+    }
+    logGroup(_log);
+    
+    if (_update)
+    {
+        FILE *_out = fopen(_path, "w");
+        
+        if (!_out)
+        {
+            perror(_path);
+            return 1;
+        }
+        for (size_t i = 0; i < _log.size(); i++)
+            fprintf(_out, "%s\n", _log[i].c_str());
+        fclose(_out);
+        printf("%s: %u commands\n", _path, (unsigned)_log.size());
+        return 0;
+    }
+    
+    HOST_CHECK(readLog(_path, _golden), "cannot read %s", _path);
+    for (size_t i = 0; i < _log.size() || i < _golden.size(); i++)
+    {
+        const char *_got = i < _log.size() ? _log[i].c_str() : "(none)";
+        const char *_want = i < _golden.size() ? _golden[i].c_str() : "(none)";
+        
+        HOST_CHECK(!strcmp(_got, _want), "%s:%u: %s, golden %s", _path, (unsigned)i + 1, _got, _want);
+    }
+    
+    return hostTestResult("EdgeLogTest");
+}
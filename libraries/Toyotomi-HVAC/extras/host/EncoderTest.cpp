@@ -0,0 +1,131 @@
+/*
+ * EncoderTest.cpp - Packed frames against the original bit array encoder
+ *
+ * Every state the constructor accepts (temperatures 16 - 31, all modes,
+ * fan speeds and timer pairs) is sent with forceResend(), and powerOn()
+ * for every state without timers. The six packed bytes the library hands
+ * to the transmitter have to hold the same 48 bits the original library
+ * built with _createByteArray(), one byte per bit, from the command and
+ * check words assembled as it did. With TOYOTOMI_FRAME_TABLE this covers
+ * the table as well.
+ *
+ * Release into the public domain.
+*/
+
+#include <Toyotomi.h>
+#include <MockHal.h>
+#include "HostTest.h"
+
+// keeps the frames instead of transmitting them
+class CaptureToyotomi : public Toyotomi
+{
+    public:
+        CaptureToyotomi(uint8_t _temp, Mode _mode, FanSpeed _fanSpeed, TimerTime _timerOn,
+                        TimerTime _timerOff, bool _active)
+            : Toyotomi(_temp, _mode, _fanSpeed, _timerOn, _timerOff, _active)
+        {
+        }
+        
+        uint8_t frame[IR_FRAME_LEN];
+        unsigned frames;
+    
+    protected:
+        void _transmit(const uint8_t _data[], const uint8_t)
+        {
+            memcpy(this->frame, _data, IR_FRAME_LEN);
+            this->frames++;
+        }
+};
+
+// the original Toyotomi::_createByteArray()
+static void createByteArray(const uint32_t inputHex, const uint32_t inputHexInv, uint8_t dataIn[],
+                            const uint8_t dataLength)
+{
+    for (unsigned i = 0; i < dataLength / 2; i++)
+    {
+        dataIn[i % 8 + 16 * (i / 8)] = (inputHex >> ((dataLength / 2) - ((i / 8) * 8) - (8 - i % 8))) & 1;
+        dataIn[i % 8 + 16 * (i / 8) + 8] = (inputHexInv >> ((dataLength / 2) - ((i / 8) * 8) - (8 - i % 8))) & 1;
+    }
+}
+
+// the original state word and its check word, from the unit's getters
+static void originalWords(Toyotomi &_unit, const bool _withTimers, uint32_t &sendValNor, uint32_t &sendValInv)
+{
+    uint8_t _temperature = _unit.getTemperature();
+    uint32_t _tempBits = tempMap[_temperature >= MIN_TEMP && _temperature <= MAX_TEMP ? _temperature - MIN_TEMP : 0];
+    
+    sendValNor = (TEMP_MASK & _tempBits) |
+                 (MODE_MASK & modeMap[_unit.getMode()]) |
+                 (FANSPEED_MASK & fanSpeedMap[_unit.getFanSpeed()]) |
+                 (TIMOFFTIM_MASK & timerOffMap[_unit.getTimerOff()]) |
+                 (DEFAULT_MASK & DEFAULT_HEAD);
+    
+    if (!_withTimers || (_unit.getTimerOn() == HOUR000 && _unit.getTimerOff() == HOUR000))
+        sendValInv = ~sendValNor;
+    else
+        sendValInv = (~sendValNor & INVERTED_MASK) |
+                     (sendValNor & TIMENCOM_MASK) |
+                     (ONTIMER_MASK & ONTIMERVAL) |
+                     (TIMONTIM_MASK & timerOnMap[_unit.getTimerOn()]) |
+                     (_unit.getTimerOn() == HOUR000 ? TIMONTIM_MASK & NOTIMONVAL : 0);
+}
+
+static void checkFrame(CaptureToyotomi &_unit, const bool _withTimers, const char *_sentBy)
+{
+    uint8_t _bits[DEFAULT_DATA_LEN];
+    uint32_t sendValNor, sendValInv;
+    
+    originalWords(_unit, _withTimers, sendValNor, sendValInv);
+    createByteArray(sendValNor, sendValInv, _bits, DEFAULT_DATA_LEN);
+    
+    for (uint8_t i = 0; i < DEFAULT_DATA_LEN; i++)
+    {
+        uint8_t _packed = (_unit.frame[i / 8] >> (i % 8)) & 1;
+        
+        HOST_CHECK(_packed == _bits[i], "%s: temp %u mode %u fan %u timers %u/%u: bit %u is %u, was %u",
+                   _sentBy, _unit.getTemperature(), _unit.getMode(), _unit.getFanSpeed(), _unit.getTimerOn(),
+                   _unit.getTimerOff(), i, _packed, _bits[i]);
+    }
+}
+
+int main()
+{
+    unsigned long _states = 0;
+    
+    mockHalReset();
+    mockHalKeepEdges(false);
+    
+    for (uint8_t _temp = MIN_TEMP - 1; _temp <= MAX_TEMP + 1; _temp++)
+    {
+        for (int _mode = AUTO; _mode <= FAN; _mode++)
+        {
+            for (int _fanSpeed = NONE_SP; _fanSpeed <= HIGH_SP; _fanSpeed++)
+            {
+                CaptureToyotomi _off(_temp, (Mode)_mode, (FanSpeed)_fanSpeed, HOUR000, HOUR000, false);
+                
+                _off.frames = 0;
+                _off.powerOn();
+                HOST_CHECK(_off.frames == 1, "powerOn() sent %u frames", _off.frames);
+                checkFrame(_off, false, "powerOn");
+                
+                for (int _timerOn = HOUR000; _timerOn <= HOUR240; _timerOn++)
+                {
+                    for (int _timerOff = HOUR000; _timerOff <= HOUR240; _timerOff++)
+                    {
+                        CaptureToyotomi _unit(_temp, (Mode)_mode, (FanSpeed)_fanSpeed, (TimerTime)_timerOn,
+                                              (TimerTime)_timerOff, true);
+                        
+                        _unit.frames = 0;
+                        _unit.forceResend();
+                        HOST_CHECK(_unit.frames == 1, "forceResend() sent %u frames", _unit.frames);
+                        checkFrame(_unit, true, "forceResend");
+                        _states++;
+                    }
+                }
+            }
+        }
+    }
+    
+    printf("%lu states\n", _states);
+    return hostTestResult("EncoderTest");
+}
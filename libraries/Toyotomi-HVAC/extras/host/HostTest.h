@@ -0,0 +1,45 @@
+/*
+ * HostTest.h - Checks shared by the host tests
+ *
+ * HOST_CHECK(condition, format, ...) counts a failure and prints the first
+ * HOST_MAX_REPORTS of them; hostTestResult() prints the verdict and gives
+ * the exit status. Run through "make check".
+ *
+ * Release into the public domain.
+*/
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+
+#define HOST_MAX_REPORTS 20
+
+static unsigned hostFailures = 0;
+
+#define HOST_CHECK(_condition, ...) \
+    do \
+    { \
+        if (_condition) \
+            break; \
+        if (hostFailures++ < HOST_MAX_REPORTS) \
+        { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fputc('\n', stderr); \
+        } \
+    } while (0)
+
+static inline int hostTestResult(const char *_name)
+{
+    if (hostFailures)
+    {
+        fprintf(stderr, "%s: %u failed\n", _name, hostFailures);
+        return 1;
+    }
+    
+    printf("%s: ok\n", _name);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,344 @@
+/*
+ * MockHal.cpp - Host backend for ToyotomiHal.h
+ * 
+ * Release into the public domain.
+*/
+
+#include <Toyotomi.h>
+#include "MockHal.h"
+#include "Timer2Mock.h"
+
+#define MOCK_PINS     32
+#define OC2A_PIN      11
+#define MOCK_TIMER0_OVERFLOW (64 * 256)     // cycles, prescaler 64 as set by the Arduino core
+
+extern "C" void TIMER1_COMPA_vect(void) __attribute__((weak));
+
+struct MockHalNode
+{
+    uint64_t now;
+    std::vector<MockEdge> edges;
+    bool keepEdges;
+    uint8_t pinLevel[MOCK_PINS];
+    bool pinOutput[MOCK_PINS];
+    bool irqEnabled;
+    uint64_t irqOffSince;
+    uint64_t irqOffTotal;
+    uint64_t irqOffLongest;
+    uint32_t uartBaud;
+    bool t1Running;
+    bool t1Pending;
+    uint64_t t1Base;        // cycle at which TCNT1 last was 0
+    uint64_t wakeAt;        // interrupt from outside the mock, 0 if none
+    
+    MockHalNode() : now(0), keepEdges(true), pinLevel(), pinOutput(), irqEnabled(true), irqOffSince(0),
+                    irqOffTotal(0), irqOffLongest(0), uartBaud(0), t1Running(false), t1Pending(false), t1Base(0),
+                    wakeAt(0)
+    {
+    }
+};
+
+static MockHalNode _default;
+static thread_local MockHalNode *_hal = &_default;
+
+
+static void _record(uint8_t _pin, uint8_t _level, bool _carrier)
+{
+    MockEdge _edge = { _hal->now, _pin, _level, _carrier };
+    
+    if (_hal->keepEdges)
+        _hal->edges.push_back(_edge);
+}
+
+static unsigned _timer1Prescale(void)
+{
+    static const unsigned _prescale[] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+    
+    return _prescale[TCCR1B & 7];
+}
+
+static bool _timer1Armed(void)
+{
+    return TIMER1_COMPA_vect && _timer1Prescale() && (TIMSK1 & _BV(OCIE1A));
+}
+
+static void _timer1Match(void)
+{
+    if (_hal->irqEnabled)
+        TIMER1_COMPA_vect();
+    else
+        _hal->t1Pending = true;
+}
+
+// cycle of the next Timer1 compare match, 0 when the timer is idle
+static uint64_t _timer1Next(void)
+{
+    unsigned _prescale = _timer1Prescale();
+    
+    if (!_timer1Armed())
+    {
+        _hal->t1Running = false;
+        return 0;
+    }
+    if (!_hal->t1Running)
+    {
+        _hal->t1Base = _hal->now - (uint64_t)TCNT1 * _prescale;
+        _hal->t1Running = true;
+    }
+    
+    return _hal->t1Base + (uint64_t)(OCR1A + 1) * _prescale;
+}
+
+
+void mockHalReset()
+{
+    _hal->now = 0;
+    _hal->edges.clear();
+    memset(_hal->pinLevel, 0, sizeof(_hal->pinLevel));
+    memset(_hal->pinOutput, 0, sizeof(_hal->pinOutput));
+    _hal->irqEnabled = true;
+    _hal->irqOffSince = _hal->irqOffTotal = _hal->irqOffLongest = 0;
+    _hal->uartBaud = 0;
+    _hal->t1Running = _hal->t1Pending = false;
+    _hal->wakeAt = 0;
+    TCCR1A = TCCR1B = TIMSK1 = TIFR1 = 0;
+    TCNT1 = OCR1A = 0;
+    timer2Reset();
+}
+
+uint64_t mockHalCycles()
+{
+    return _hal->now;
+}
+
+double mockHalMicros()
+{
+    return _hal->now * 1e6 / F_CPU;
+}
+
+void mockHalAdvance(uint64_t _cycles)
+{
+    uint64_t _end = _hal->now + _cycles;
+    uint64_t _match;
+    
+    while ((_match = _timer1Next()) && _match <= _end)
+    {
+        _hal->now = _hal->t1Base = _match;
+        TCNT1 = 0;
+        _timer1Match();
+    }
+    _hal->now = _end;
+    if (_hal->t1Running)
+        TCNT1 = (_hal->now - _hal->t1Base) / _timer1Prescale();
+}
+
+const std::vector<MockEdge> &mockHalEdges()
+{
+    return _hal->edges;
+}
+
+void mockHalClearEdges()
+{
+    _hal->edges.clear();
+}
+
+bool mockHalPinIsOutput(uint8_t _pin)
+{
+    return _pin < MOCK_PINS && _hal->pinOutput[_pin];
+}
+
+bool mockHalIrqEnabled()
+{
+    return _hal->irqEnabled;
+}
+
+uint64_t mockHalIrqOffCycles()
+{
+    return _hal->irqOffTotal + (_hal->irqEnabled ? 0 : _hal->now - _hal->irqOffSince);
+}
+
+uint64_t mockHalIrqOffLongest()
+{
+    return _hal->irqOffLongest;
+}
+
+void mockHalUartFlood(uint32_t _baud)
+{
+    _hal->uartBaud = _baud;
+}
+
+// an interrupt at _cycle that the mock does not model, e.g. a received character
+void mockHalWakeAt(uint64_t _cycle)
+{
+    _hal->wakeAt = _cycle;
+}
+
+void mockHalKeepEdges(bool _keep)
+{
+    _hal->keepEdges = _keep;
+}
+
+MockHalNode *mockHalNewNode()
+{
+    return new MockHalNode();
+}
+
+void mockHalDeleteNode(MockHalNode *_node)
+{
+    if (_hal == _node)
+        _hal = &_default;
+    delete _node;
+}
+
+void mockHalSelect(MockHalNode *_node)
+{
+    _hal = _node ? _node : &_default;
+}
+
+
+void halPinOutput(uint8_t _pin)
+{
+    if (_pin < MOCK_PINS)
+        _hal->pinOutput[_pin] = true;
+}
+
+static void _setPin(uint8_t _pin, uint8_t _level)
+{
+    _level = _level ? HIGH : LOW;
+    if (_pin >= MOCK_PINS || _hal->pinLevel[_pin] == _level)
+        return;
+    
+    _hal->pinLevel[_pin] = _level;
+    if (_hal->pinOutput[_pin])
+        _record(_pin, _level, false);
+}
+
+// every write takes the cycles Toyotomi.h budgets for it, the edge is at its start
+void halPinWrite(uint8_t _pin, uint8_t _level)
+{
+    _setPin(_pin, _level);
+    mockHalAdvance(IR_PIN_WRITE_CYCLES);
+}
+
+void halPortPinWrite(uint8_t _pin, uint8_t _level)
+{
+    _setPin(_pin, _level);
+    mockHalAdvance(IR_PORT_WRITE_CYCLES);
+}
+
+void halPortHigh(uint8_t _mask)
+{
+    for (uint8_t i = 0; i < 6; i++)
+        if (_mask & _BV(i))
+            _setPin(8 + i, HIGH);
+    mockHalAdvance(IR_MASK_WRITE_CYCLES);
+}
+
+void halPortLow(uint8_t _mask)
+{
+    for (uint8_t i = 0; i < 6; i++)
+        if (_mask & _BV(i))
+            _setPin(8 + i, LOW);
+    mockHalAdvance(IR_MASK_WRITE_CYCLES);
+}
+
+void halDelayUs(unsigned int _us)
+{
+    mockHalAdvance((uint64_t)_us * F_CPU / 1000000L);
+}
+
+void halSpinCycles(uint32_t _cycles)
+{
+    mockHalAdvance(_cycles);
+}
+
+void halIrqOff()
+{
+    if (!_hal->irqEnabled)
+        return;
+    
+    _hal->irqEnabled = false;
+    _hal->irqOffSince = _hal->now;
+}
+
+void halIrqOn()
+{
+    if (_hal->irqEnabled)
+        return;
+    
+    _hal->irqEnabled = true;
+    _hal->irqOffTotal += _hal->now - _hal->irqOffSince;
+    if (_hal->now - _hal->irqOffSince > _hal->irqOffLongest)
+        _hal->irqOffLongest = _hal->now - _hal->irqOffSince;
+    if (_hal->t1Pending)
+    {
+        _hal->t1Pending = false;
+        TIMER1_COMPA_vect();
+    }
+}
+
+uint32_t halMillis()
+{
+    return _hal->now * 1000 / F_CPU;
+}
+
+uint32_t halMicros()
+{
+    return _hal->now * 1000000 / F_CPU;
+}
+
+uint32_t halCycles()
+{
+    return _hal->now;
+}
+
+// wakes at the next Timer1 match, at mockHalWakeAt() or at the Timer0 overflow behind millis()
+void halSleep()
+{
+    uint64_t _match = _timer1Next();
+    uint64_t _tick = (_hal->now / MOCK_TIMER0_OVERFLOW + 1) * MOCK_TIMER0_OVERFLOW;
+    
+    if (_match > _hal->now && _match < _tick)
+        _tick = _match;
+    if (_hal->wakeAt > _hal->now && _hal->wakeAt < _tick)
+        _tick = _hal->wakeAt;
+    mockHalAdvance(_tick - _hal->now);
+}
+
+// 10 bits per character, two in the receive buffer and one in the shifter
+bool halUartOverrun()
+{
+    if (!_hal->uartBaud || _hal->irqEnabled)
+        return false;
+    
+    return _hal->now - _hal->irqOffSince >= 3 * 10 * (uint64_t)F_CPU / _hal->uartBaud;
+}
+
+uint16_t halReadWord(const void *_addr)
+{
+    uint16_t _word;
+    
+    memcpy(&_word, _addr, sizeof(_word));
+    return _word;
+}
+
+void halCarrierBegin(uint8_t _clockSelect, uint8_t _top)
+{
+    TCCR2A = _BV(WGM21);
+    TCCR2B = _clockSelect;
+    OCR2A = _top;
+    TCNT2 = 0;
+}
+
+void halCarrierOn()
+{
+    TCCR2A |= _BV(COM2A0);
+    if (timer2CarrierEnabled())
+        _record(OC2A_PIN, HIGH, true);
+}
+
+void halCarrierOff()
+{
+    TCCR2A &= ~_BV(COM2A0);
+    _record(OC2A_PIN, _hal->pinLevel[OC2A_PIN], false);
+}
@@ -0,0 +1,57 @@
+/*
+ * MockHal.h - Host backend for ToyotomiHal.h
+ * 
+ * Nothing sleeps: delays advance a virtual clock counted in CPU cycles
+ * (F_CPU per second) and every level change on a pin is recorded with its
+ * timestamp. Other instructions take no time, except the pin writes and
+ * carrier loops the library times its delays around: they cost the
+ * IR_*_CYCLES of Toyotomi.h, as on the AVR. Timer1 is simulated far enough to call TIMER1_COMPA_vect at its
+ * compare matches, which is all the background transmitter needs.
+ * mockHalUartFlood() models a serial port receiving back-to-back bytes at
+ * the given baud rate: halUartOverrun() reports an overrun once interrupts
+ * have been off for the three characters its buffers can hold.
+ * 
+ * Clock, pins and interrupt state belong to a node. Every thread starts on
+ * the process-wide one; mockHalSelect() switches the calling thread to a
+ * node of its own, so several simulated boards can run on as many threads.
+ * The AVR timer registers stay shared, so only one node at a time may use
+ * the Timer1 or Timer2 transmitters.
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef MOCK_HAL_H
+#define MOCK_HAL_H
+
+#include <ToyotomiHal.h>
+#include <vector>
+
+struct MockEdge
+{
+    uint64_t cycle;
+    uint8_t pin;
+    uint8_t level;
+    bool carrier;       // level 1 is the Timer2 carrier gated onto OC2A
+};
+
+void mockHalReset(void);
+uint64_t mockHalCycles(void);
+double mockHalMicros(void);
+void mockHalAdvance(uint64_t);
+const std::vector<MockEdge> &mockHalEdges(void);
+void mockHalClearEdges(void);
+bool mockHalPinIsOutput(uint8_t);
+bool mockHalIrqEnabled(void);
+uint64_t mockHalIrqOffCycles(void);
+uint64_t mockHalIrqOffLongest(void);
+void mockHalUartFlood(uint32_t);
+void mockHalWakeAt(uint64_t);
+void mockHalKeepEdges(bool);
+
+struct MockHalNode;
+
+MockHalNode *mockHalNewNode(void);
+void mockHalDeleteNode(MockHalNode *);
+void mockHalSelect(MockHalNode *);
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * RawTest.cpp - The ToyotomiRaw.h record, encoded and read back
+ *
+ * IRRaw::encode() of a frame, parse() and expand() have to give the
+ * protocol's own marks and spaces for every symbol of every pass, and the
+ * header the carrier and unit. A protocol of one long run checks that a
+ * run longer than one repeat byte holds is split. Truncated records and
+ * a wrong magic parse to 0.
+ *
+ * Release into the public domain.
+*/
+
+#include <string.h>
+#include <vector>
+#include <Toyotomi.h>
+#include <ToyotomiRaw.h>
+#include "HostTest.h"
+
+#define RUN_SYMBOLS 200
+
+// RUN_SYMBOLS identical symbols
+struct RunProtocol
+{
+    static constexpr long carrierHz = 40000L;
+    static constexpr uint16_t unitUs = 600;
+    static constexpr uint8_t symbols = RUN_SYMBOLS;
+    
+    static inline uint8_t mark(const uint8_t) { return 2; }
+    static inline uint8_t space(const uint8_t [], const uint8_t) { return 5; }
+};
+
+struct Pair
+{
+    uint8_t mark;
+    uint8_t space;
+};
+
+template <class Protocol>
+static void checkRoundTrip(const char *_name, const uint8_t _frame[], const uint8_t _passes)
+{
+    std::vector<uint8_t> _record;
+    std::vector<Pair> _pairs;
+    IRRawRecord _parsed = { 0, 0, NULL, 0 };
+    uint16_t _length;
+    size_t _symbol = 0;
+    
+    IRRaw::encode<Protocol>(_frame, _passes, [&_record](uint8_t _byte) { _record.push_back(_byte); });
+    _length = IRRaw::parse(&_record[0], _record.size(), _parsed);
+    HOST_CHECK(_length == _record.size(), "%s x%u: parsed %u of %u bytes", _name, _passes, _length,
+               (unsigned)_record.size());
+    if (_length != _record.size())
+        return;
+    HOST_CHECK(_parsed.carrierHz == Protocol::carrierHz && _parsed.unitUs == Protocol::unitUs,
+               "%s x%u: header %u Hz, %u us", _name, _passes, _parsed.carrierHz, _parsed.unitUs);
+    
+    IRRaw::expand(_parsed, [&_pairs](uint8_t _mark, uint8_t _space) { _pairs.push_back(Pair { _mark, _space }); });
+    HOST_CHECK(_pairs.size() == (size_t)_passes * Protocol::symbols, "%s x%u: %u pairs", _name, _passes,
+               (unsigned)_pairs.size());
+    for (uint8_t _pass = 0; _pass < _passes; _pass++)
+    {
+        for (uint8_t i = 0; i < Protocol::symbols && _symbol < _pairs.size(); i++, _symbol++)
+        {
+            HOST_CHECK(_pairs[_symbol].mark == Protocol::mark(i) && _pairs[_symbol].space == Protocol::space(_frame, i),
+                       "%s x%u: symbol %u of pass %u is %u/%u units, not %u/%u", _name, _passes, i, _pass,
+                       _pairs[_symbol].mark, _pairs[_symbol].space, Protocol::mark(i), Protocol::space(_frame, i));
+        }
+    }
+    
+    HOST_CHECK(!IRRaw::parse(&_record[0], _record.size() - 1, _parsed), "%s x%u: truncated record parsed", _name,
+               _passes);
+    _record[0] = ~IR_RAW_MAGIC;
+    HOST_CHECK(!IRRaw::parse(&_record[0], _record.size(), _parsed), "%s x%u: wrong magic parsed", _name, _passes);
+}
+
+int main()
+{
+    static const uint8_t _frames[][IR_FRAME_LEN] = {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },
+        { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF },
+        { 0xA5, 0x5A, 0x0F, 0xF0, 0x33, 0xCC },
+        { 0x4D, 0xB2, 0xF8, 0x07, 0x1B, 0xE4 }
+    };
+    static const char *_names[] = { "zeros", "ones", "alternating", "mixed" };
+    
+    for (uint8_t i = 0; i < sizeof(_frames) / sizeof(_frames[0]); i++)
+    {
+        checkRoundTrip<ToyotomiProtocol>(_names[i], _frames[i], 1);
+        checkRoundTrip<ToyotomiProtocol>(_names[i], _frames[i], 2);
+    }
+    checkRoundTrip<RunProtocol>("run", _frames[0], 1);
+    checkRoundTrip<RunProtocol>("run", _frames[0], 3);
+    
+    return hostTestResult("RawTest");
+}
@@ -0,0 +1,91 @@
+/*
+ * ResendTest.cpp - Skipped frames, forceResend() and setResendInterval()
+ *
+ * A state or power off frame the unit got last is not sent again and is
+ * counted by getSkippedFrames(). forceResend() sends it anyway, and with a
+ * resend interval it goes out again once that much time has passed since
+ * it was last sent. Toggles are never skipped.
+ *
+ * Release into the public domain.
+*/
+
+#include <Toyotomi.h>
+#include <MockHal.h>
+#include "HostTest.h"
+#include "TraceFrames.h"
+
+#define CYCLES_PER_MS (F_CPU / 1000)
+
+#define CHECK_SKIPPED(_unit, _skipped) \
+    HOST_CHECK((_unit).getSkippedFrames() == (_skipped), "line %d: %u frames skipped, not %u", __LINE__, \
+               (_unit).getSkippedFrames(), (_skipped))
+
+static void checkSkipping(void)
+{
+    Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    
+    CHECK_SENDS(_unit, _unit.setTemperature(25), "state");
+    CHECK_SKIPPED(_unit, 0);
+    CHECK_SENDS(_unit, _unit.setTemperature(25), "");
+    CHECK_SENDS(_unit, _unit.setMode(COOL), "");
+    CHECK_SENDS(_unit, _unit.setState(25, COOL, HIGH_SP), "");
+    CHECK_SKIPPED(_unit, 3);
+    CHECK_SENDS(_unit, _unit.setTemperature(26), "state");
+    CHECK_SENDS(_unit, _unit.setTemperature(25), "state");
+    
+    CHECK_SENDS(_unit, _unit.forceResend(), "state");
+    CHECK_SENDS(_unit, _unit.forceResend(), "state");
+    CHECK_SENDS(_unit, _unit.setTemperature(25), "");
+    CHECK_SKIPPED(_unit, 4);
+    
+    CHECK_SENDS(_unit, _unit.buttonSwing(), "swing");
+    CHECK_SENDS(_unit, _unit.buttonSwing(), "swing");
+    
+    CHECK_SENDS(_unit, _unit.powerOff(), "off");
+    CHECK_SENDS(_unit, _unit.powerOff(), "");
+    CHECK_SKIPPED(_unit, 5);
+    CHECK_SENDS(_unit, _unit.forceResend(), "off");
+    CHECK_SENDS(_unit, _unit.powerOn(), "state");
+}
+
+static void checkInterval(void)
+{
+    Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    
+    _unit.setResendInterval(1000);
+    CHECK_SENDS(_unit, _unit.forceResend(), "state");
+    CHECK_SENDS(_unit, _unit.setTemperature(24), "");
+    CHECK_SKIPPED(_unit, 1);
+    
+    mockHalAdvance(500 * CYCLES_PER_MS);
+    CHECK_SENDS(_unit, _unit.setTemperature(24), "");
+    mockHalAdvance(600 * CYCLES_PER_MS);
+    CHECK_SENDS(_unit, _unit.setTemperature(24), "state");
+    CHECK_SKIPPED(_unit, 2);
+    
+    // the interval counts from that resend
+    CHECK_SENDS(_unit, _unit.setTemperature(24), "");
+    mockHalAdvance(1000 * CYCLES_PER_MS);
+    CHECK_SENDS(_unit, _unit.setTemperature(24), "state");
+    
+    _unit.setResendInterval(0);
+    mockHalAdvance(5000 * CYCLES_PER_MS);
+    CHECK_SENDS(_unit, _unit.setTemperature(24), "");
+    CHECK_SKIPPED(_unit, 4);
+    
+    _unit.setResendInterval(1000);
+    CHECK_SENDS(_unit, _unit.powerOff(), "off");
+    mockHalAdvance(1000 * CYCLES_PER_MS);
+    CHECK_SENDS(_unit, _unit.powerOff(), "off");
+}
+
+int main()
+{
+    mockHalReset();
+    mockHalKeepEdges(false);
+    
+    checkSkipping();
+    checkInterval();
+    
+    return hostTestResult("ResendTest");
+}
@@ -0,0 +1,89 @@
+/*
+ * Timer2Mock.cpp - Carrier readback for the host-side Timer2 registers
+ * 
+ * Release into the public domain.
+*/
+
+#include "Timer2Mock.h"
+
+static const unsigned prescaler[] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+
+static uint8_t _waveMode(void)
+{
+    return (TCCR2A & (_BV(WGM21) | _BV(WGM20))) | ((TCCR2B & _BV(WGM22)) >> 1);
+}
+
+void timer2Reset()
+{
+    TCCR2A = TCCR2B = TCNT2 = OCR2A = OCR2B = 0;
+}
+
+bool timer2CarrierEnabled()
+{
+    uint8_t _com = (TCCR2A >> COM2A0) & 3;
+    
+    if (!prescaler[TCCR2B & 7] || !_com)
+        return false;
+    // In the fixed-TOP PWM modes COM2A0 alone leaves OC2A disconnected
+    if ((_waveMode() == 1 || _waveMode() == 3) && _com == 1)
+        return false;
+    
+    return true;
+}
+
+double timer2CarrierHz(unsigned long fcpu)
+{
+    if (!timer2CarrierEnabled())
+        return 0;
+    
+    return timer2ConfiguredHz(fcpu);
+}
+
+// OC2A frequency in the current waveform mode, whether or not it is connected
+double timer2ConfiguredHz(unsigned long fcpu)
+{
+    double _tick;
+    
+    if (!prescaler[TCCR2B & 7])
+        return 0;
+    
+    _tick = (double)fcpu / prescaler[TCCR2B & 7];
+    switch (_waveMode())
+    {
+        case 1:                          // phase correct, TOP = 0xFF
+            return _tick / 510;
+        case 2:                          // CTC, toggle on match
+            return _tick / (2.0 * (1 + OCR2A));
+        case 3:                          // fast PWM, TOP = 0xFF
+            return _tick / 256;
+        case 5:                          // phase correct, TOP = OCR2A (toggle)
+            return _tick / (4.0 * OCR2A);
+        case 7:                          // fast PWM, TOP = OCR2A (toggle)
+            return _tick / (2.0 * (1 + OCR2A));
+        default:                         // normal mode, toggle on match
+            return _tick / 512;
+    }
+}
+
+double timer2CarrierDuty()
+{
+    uint8_t _com = (TCCR2A >> COM2A0) & 3;
+    double _duty;
+    
+    if (!timer2CarrierEnabled())
+        return 0;
+    
+    switch (_waveMode())
+    {
+        case 1:
+            _duty = OCR2A / 255.0;
+            break;
+        case 3:
+            _duty = (OCR2A + 1) / 256.0;
+            break;
+        default:                         // toggle modes are always square
+            return 0.5;
+    }
+    
+    return _com == 3 ? 1 - _duty : _duty;
+}
@@ -0,0 +1,21 @@
+/*
+ * Timer2Mock.h - Carrier readback for the host-side Timer2 registers
+ * 
+ * Decodes the values written to TCCR2A/TCCR2B/OCR2A/OCR2B the way the
+ * ATmega328P would and reports the waveform seen on OC2A (pin 11).
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef TIMER2_MOCK_H
+#define TIMER2_MOCK_H
+
+#include <avr/io.h>
+
+void timer2Reset(void);
+bool timer2CarrierEnabled(void);
+double timer2CarrierHz(unsigned long fcpu);
+double timer2ConfiguredHz(unsigned long fcpu);
+double timer2CarrierDuty(void);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * ToggleTest.cpp - The absolute setters of the toggled functions
+ *
+ * setSwing(), setTurbo(), setCleanAir() and setLedDisplay() send the
+ * toggle only when the tracked state differs and return the state they
+ * leave. Swing, turbo and clean air need the unit on, the LED display
+ * does not. Inside a batch only the net change is sent.
+ *
+ * Release into the public domain.
+*/
+
+#include <Toyotomi.h>
+#include <MockHal.h>
+#include "HostTest.h"
+#include "TraceFrames.h"
+
+struct Feature
+{
+    const char *name;           // as frameTypes() names its frame
+    bool (Toyotomi::*set)(bool);
+    bool (Toyotomi::*isOn)(void);
+    bool needsPower;
+};
+
+static const Feature features[] = {
+    { "swing",    &Toyotomi::setSwing,      &Toyotomi::isSwingOn,      true },
+    { "turbo",    &Toyotomi::setTurbo,      &Toyotomi::isTurboOn,      true },
+    { "cleanair", &Toyotomi::setCleanAir,   &Toyotomi::isCleanAirOn,   true },
+    { "led",      &Toyotomi::setLedDisplay, &Toyotomi::isLedDisplayOn, false }
+};
+
+static void checkFeature(Toyotomi &_unit, const Feature &_feature, const bool _on, const bool _sends)
+{
+    uint16_t _before = _unit.getFramesSent();
+    bool _was = (_unit.*_feature.isOn)();
+    bool _now = (_unit.*_feature.set)(_on);
+    std::string _sent = frameTypes(traceFrames(_unit, _before));
+    bool _expected = _sends ? _on : _was;
+    
+    HOST_CHECK(_sent == (_sends ? _feature.name : ""), "%s(%d) from %d, %s: sent \"%s\"", _feature.name, _on, _was,
+               _unit.isPoweredOn() ? "on" : "off", _sent.c_str());
+    HOST_CHECK(_now == _expected && (_unit.*_feature.isOn)() == _expected, "%s(%d) from %d returns %d, state %d",
+               _feature.name, _on, _was, _now, (_unit.*_feature.isOn)());
+}
+
+static void checkSetters(void)
+{
+    Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    
+    for (size_t i = 0; i < sizeof(features) / sizeof(features[0]); i++)
+    {
+        const Feature &_feature = features[i];
+        bool _on = (_unit.*_feature.isOn)();
+        
+        checkFeature(_unit, _feature, _on, false);
+        checkFeature(_unit, _feature, !_on, true);
+        checkFeature(_unit, _feature, !_on, false);
+        checkFeature(_unit, _feature, _on, true);
+    }
+    
+    _unit.powerOff();
+    for (size_t i = 0; i < sizeof(features) / sizeof(features[0]); i++)
+    {
+        const Feature &_feature = features[i];
+        bool _on = (_unit.*_feature.isOn)();
+        
+        checkFeature(_unit, _feature, !_on, !_feature.needsPower);
+        checkFeature(_unit, _feature, _on, !_feature.needsPower);
+    }
+}
+
+static void checkBatch(void)
+{
+    Toyotomi _unit(24, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    
+    CHECK_SENDS(_unit, _unit.forceResend(), "state");
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.setSwing(true), _unit.setSwing(false), _unit.commit()), "");
+    CHECK_SENDS(_unit, (_unit.beginUpdate(), _unit.setTurbo(true), _unit.setTurbo(true), _unit.setLedDisplay(false),
+                        _unit.commit()), "turbo led");
+    HOST_CHECK(_unit.isTurboOn() && !_unit.isLedDisplayOn(), "batch left turbo %d, LED display %d",
+               _unit.isTurboOn(), _unit.isLedDisplayOn());
+}
+
+int main()
+{
+    mockHalReset();
+    mockHalKeepEdges(false);
+    
+    checkSetters();
+    checkBatch();
+    
+    return hostTestResult("ToggleTest");
+}
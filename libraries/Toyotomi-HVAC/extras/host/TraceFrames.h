@@ -0,0 +1,97 @@
+/*
+ * TraceFrames.h - The frames a unit sent, read back from the trace
+ *
+ * traceFrames() waits for the transmitter and returns the frames _unit
+ * sent since its getFramesSent() was _before, oldest first, as
+ * Toyotomi::dumpTrace() writes them. They have to be the last frames
+ * traced and at most IR_TRACE_LEN, which every mode records the same way.
+ *
+ * CHECK_SENDS(unit, call, "state swing") checks the kinds of frames a call
+ * sent, in order, as frameTypes() names them.
+ *
+ * Release into the public domain.
+*/
+
+#ifndef TRACE_FRAMES_H
+#define TRACE_FRAMES_H
+
+#include <string.h>
+#include <string>
+#include <vector>
+#include <Toyotomi.h>
+#include <ToyotomiCodec.h>
+#include "HostTest.h"
+
+struct TracedFrame
+{
+    uint32_t at;
+    uint8_t frame[IR_FRAME_LEN];
+    uint8_t tag;
+};
+
+static inline std::vector<TracedFrame> traceFrames(Toyotomi &_unit, const uint16_t _before)
+{
+    uint8_t _dump[IR_TRACE_LEN * IR_TRACE_ENTRY_BYTES];
+    uint16_t _sent = _unit.getFramesSent() - _before;
+    uint8_t _count;
+    std::vector<TracedFrame> _frames;
+    
+    while (_unit.isTransmitting())
+        Toyotomi::idle();
+    
+    _count = Toyotomi::dumpTrace(_dump) / IR_TRACE_ENTRY_BYTES;
+    HOST_CHECK(_sent <= _count, "%u frames sent, %u traced", _sent, _count);
+    for (uint8_t i = _count - (_sent < _count ? _sent : _count); i < _count; i++)
+    {
+        const uint8_t *_entry = _dump + i * IR_TRACE_ENTRY_BYTES;
+        TracedFrame _frame;
+        
+        _frame.at = _entry[0] | (uint32_t)_entry[1] << 8 | (uint32_t)_entry[2] << 16 | (uint32_t)_entry[3] << 24;
+        memcpy(_frame.frame, _entry + 4, IR_FRAME_LEN);
+        _frame.tag = _entry[4 + IR_FRAME_LEN];
+        _frames.push_back(_frame);
+    }
+    
+    return _frames;
+}
+
+static inline bool sameFrames(const std::vector<TracedFrame> &_a, const std::vector<TracedFrame> &_b)
+{
+    if (_a.size() != _b.size())
+        return false;
+    for (size_t i = 0; i < _a.size(); i++)
+        if (memcmp(_a[i].frame, _b[i].frame, IR_FRAME_LEN))
+            return false;
+    
+    return true;
+}
+
+// "state timer off air swing cleanair led turbo", a name per frame
+static inline std::string frameTypes(const std::vector<TracedFrame> &_frames)
+{
+    static const char *_names[] = { "invalid", "state", "timer", "off", "air", "swing", "cleanair", "led", "turbo" };
+    std::string _types;
+    ToyotomiState _state;
+    
+    for (size_t i = 0; i < _frames.size(); i++)
+    {
+        if (i)
+            _types += " ";
+        _types += _names[ToyotomiCodec::decode(_frames[i].frame, _state)];
+    }
+    
+    return _types;
+}
+
+#define CHECK_SENDS(_unit, _call, _types) \
+    do \
+    { \
+        uint16_t _sentBefore = (_unit).getFramesSent(); \
+        std::string _sentTypes; \
+        \
+        _call; \
+        _sentTypes = frameTypes(traceFrames(_unit, _sentBefore)); \
+        HOST_CHECK(_sentTypes == _types, "%s sent \"%s\", not \"%s\"", #_call, _sentTypes.c_str(), _types); \
+    } while (0)
+
+#endif
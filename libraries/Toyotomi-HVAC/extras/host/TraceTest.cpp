@@ -0,0 +1,68 @@
+/*
+ * TraceTest.cpp - The frame trace and its dump
+ *
+ * The trace keeps the last IR_TRACE_LEN frames. It is filled past its end
+ * so the ring wraps, and dumpTrace() has to return the newest frames,
+ * oldest first, each with the time it was sent (low byte first, beyond 16
+ * bits), the frame and the tag set when it was sent.
+ *
+ * Release into the public domain.
+*/
+
+#include <Toyotomi.h>
+#include <ToyotomiCodec.h>
+#include <MockHal.h>
+#include "HostTest.h"
+#include "TraceFrames.h"
+
+#define FRAMES        (IR_TRACE_LEN + 3)
+#define START_MS      0x01020304UL      // every byte of at differs
+#define FRAME_GAP_MS  1000
+
+int main()
+{
+    uint8_t _dump[IR_TRACE_LEN * IR_TRACE_ENTRY_BYTES];
+    uint32_t _sentAt[FRAMES];
+    
+    mockHalReset();
+    mockHalKeepEdges(false);
+    Toyotomi _unit(MIN_TEMP, COOL, HIGH_SP, HOUR000, HOUR000, true);
+    
+    HOST_CHECK(Toyotomi::dumpTrace(_dump) == 0, "trace not empty before the first frame");
+    
+    mockHalAdvance((uint64_t)START_MS * (F_CPU / 1000) - mockHalCycles());
+    for (uint8_t i = 0; i < FRAMES; i++)
+    {
+        Toyotomi::setCommandTag(100 + i);
+        _sentAt[i] = halMillis();
+        _unit.setTemperature(MIN_TEMP + 1 + i);
+        while (_unit.isTransmitting())
+            Toyotomi::idle();
+        mockHalAdvance((uint64_t)FRAME_GAP_MS * (F_CPU / 1000));
+        
+        if (i == 1)
+            HOST_CHECK(Toyotomi::dumpTrace(_dump) == 2 * IR_TRACE_ENTRY_BYTES, "%u bytes dumped after 2 frames",
+                       Toyotomi::dumpTrace(_dump));
+    }
+    
+    HOST_CHECK(Toyotomi::dumpTrace(_dump) == IR_TRACE_LEN * IR_TRACE_ENTRY_BYTES, "%u bytes dumped after %u frames",
+               Toyotomi::dumpTrace(_dump), FRAMES);
+    for (uint8_t i = 0; i < IR_TRACE_LEN; i++)
+    {
+        const uint8_t *_entry = _dump + i * IR_TRACE_ENTRY_BYTES;
+        uint8_t _sent = FRAMES - IR_TRACE_LEN + i;
+        uint32_t _at = _entry[0] | (uint32_t)_entry[1] << 8 | (uint32_t)_entry[2] << 16 | (uint32_t)_entry[3] << 24;
+        ToyotomiState _state;
+        FrameType _type = ToyotomiCodec::decode(_entry + 4, _state);
+        
+        HOST_CHECK(_at == _sentAt[_sent], "entry %u at %u ms, frame %u was sent at %u ms", i, _at, _sent,
+                   _sentAt[_sent]);
+        HOST_CHECK(_type == STATE_FRAME && _state.temperature == MIN_TEMP + 1 + _sent,
+                   "entry %u: frame type %u, temperature %u, not that of frame %u", i, _type, _state.temperature,
+                   _sent);
+        HOST_CHECK(_entry[4 + IR_FRAME_LEN] == 100 + _sent, "entry %u tagged %u, frame %u was tagged %u", i,
+                   _entry[4 + IR_FRAME_LEN], _sent, 100 + _sent);
+    }
+    
+    return hostTestResult("TraceTest");
+}
@@ -0,0 +1,18 @@
+/*
+ * avr/interrupt.h - Host-side stand-in for the AVR interrupt macros
+ * 
+ * Interrupt vectors become ordinary functions, so the host can call
+ * TIMER1_COMPA_vect() itself whenever the mocked timer would have fired.
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#define cli()
+#define sei()
+
+#define ISR(vector) extern "C" void vector(void)
+
+#endif
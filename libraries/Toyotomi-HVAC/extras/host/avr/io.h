@@ -0,0 +1,58 @@
+/*
+ * avr/io.h - Host-side stand-in for the AVR register file
+ * 
+ * Only the registers and bits touched by the Toyotomi library are
+ * provided. They are plain variables, so code written against the real
+ * registers compiles unchanged and its effect can be inspected afterwards.
+ * 
+ * Release into the public domain.
+*/
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint16_t TCNT1;
+extern volatile uint16_t OCR1A;
+extern volatile uint8_t TIMSK1;
+extern volatile uint8_t TIFR1;
+
+extern volatile uint8_t TCCR2A;
+extern volatile uint8_t TCCR2B;
+extern volatile uint8_t TCNT2;
+extern volatile uint8_t OCR2A;
+extern volatile uint8_t OCR2B;
+
+// TCCR1B
+#define WGM13  4
+#define WGM12  3
+#define CS12   2
+#define CS11   1
+#define CS10   0
+
+// TIMSK1 / TIFR1
+#define OCIE1A 1
+#define OCF1A  1
+
+// TCCR2A
+#define COM2A1 7
+#define COM2A0 6
+#define COM2B1 5
+#define COM2B0 4
+#define WGM21  1
+#define WGM20  0
+
+// TCCR2B
+#define FOC2A  7
+#define FOC2B  6
+#define WGM22  3
+#define CS22   2
+#define CS21   1
+#define CS20   0
+
+#endif
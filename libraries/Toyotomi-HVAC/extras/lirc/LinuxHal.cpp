@@ -0,0 +1,115 @@
+/*
+ * LinuxHal.cpp - Linux backend for ToyotomiHal.h
+ *
+ * The gateway has no IR LED pin, carrier timer or interrupts of its own,
+ * the LIRC device does all of that, so those calls do nothing. Time is the
+ * monotonic clock and the delays really sleep; halCycles() counts F_CPU
+ * cycles per second as on the node, so frame timings compare directly.
+ *
+ * Release into the public domain.
+*/
+
+#include <time.h>
+
+#include <ToyotomiHal.h>
+
+static uint64_t _nowNs(void)
+{
+    struct timespec _ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &_ts);
+    return (uint64_t)_ts.tv_sec * 1000000000ULL + _ts.tv_nsec;
+}
+
+static void _sleepNs(uint64_t _ns)
+{
+    struct timespec _ts = { (time_t)(_ns / 1000000000ULL), (long)(_ns % 1000000000ULL) };
+    
+    while (clock_nanosleep(CLOCK_MONOTONIC, 0, &_ts, &_ts))
+        ;       // interrupted by a signal, sleep the rest
+}
+
+
+void halPinOutput(uint8_t)
+{
+}
+
+void halPinWrite(uint8_t, uint8_t)
+{
+}
+
+void halPortHigh(uint8_t)
+{
+}
+
+void halPortLow(uint8_t)
+{
+}
+
+void halPortPinWrite(uint8_t, uint8_t)
+{
+}
+
+void halCarrierBegin(uint8_t, uint8_t)
+{
+}
+
+void halCarrierOn(void)
+{
+}
+
+void halCarrierOff(void)
+{
+}
+
+void halIrqOff(void)
+{
+}
+
+void halIrqOn(void)
+{
+}
+
+bool halUartOverrun(void)
+{
+    return false;
+}
+
+void halDelayUs(unsigned int _us)
+{
+    _sleepNs(_us * 1000ULL);
+}
+
+void halSpinCycles(uint32_t _cycles)
+{
+    _sleepNs(_cycles * 1000000000ULL / F_CPU);
+}
+
+// stands in for the node's wait for its next interrupt, at most a Timer0 overflow
+void halSleep(void)
+{
+    _sleepNs(1000000ULL);
+}
+
+uint32_t halMillis(void)
+{
+    return _nowNs() / 1000000ULL;
+}
+
+uint32_t halMicros(void)
+{
+    return _nowNs() / 1000ULL;
+}
+
+uint32_t halCycles(void)
+{
+    return halMicros() * (F_CPU / 1000000L);
+}
+
+uint16_t halReadWord(const void *_addr)
+{
+    uint16_t _word;
+    
+    memcpy(&_word, _addr, sizeof(_word));
+    return _word;
+}
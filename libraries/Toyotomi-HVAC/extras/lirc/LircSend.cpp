@@ -0,0 +1,138 @@
+/*
+ * LircSend.cpp - Sends Toyotomi commands through a LIRC device
+ *
+ * Usage: lirc-send device command...
+ *
+ *     lirc-send /dev/lirc0 on temp=22 mode=cool fan=high swing
+ *
+ * Commands are on, off, temp=16..30, mode=auto|cool|dry|heat|fan,
+ * fan=auto|low|med|high, swing, direction, clean, led and turbo. A single
+ * run has no idea what the unit was told before, so it does not skip
+ * anything as unchanged. Any of the state commands sends the whole state
+ * in one frame: on unless off is given, and the library defaults for the
+ * fields not given. The toggles follow it, those that need the unit on only
+ * if it is. All frames go out in one write. The device may also be a file
+ * or a FIFO, "-" is standard output.
+ *
+ * Release into the public domain.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ToyotomiLirc.h"
+
+struct Toggle
+{
+    const char *name;
+    void (Toyotomi::*button)(void);
+};
+
+static const Toggle toggles[] = {
+    { "swing",     &Toyotomi::buttonSwing },
+    { "direction", &Toyotomi::buttonAirDirection },
+    { "clean",     &Toyotomi::buttonCleanAir },
+    { "led",       &Toyotomi::buttonLedDisplay },
+    { "turbo",     &Toyotomi::buttonTurbo }
+};
+
+#define TOGGLES (sizeof(toggles) / sizeof(toggles[0]))
+
+// the state the command line asks for
+struct Request
+{
+    bool state;         // a state command was given
+    bool active;
+    uint8_t temperature;
+    Mode mode;
+    FanSpeed fanSpeed;
+};
+
+static int lookup(const char *_value, const char *const _names[], const int _count)
+{
+    for (int i = 0; i < _count; i++)
+        if (!strcmp(_value, _names[i]))
+            return i;
+
+    return -1;
+}
+
+static const Toggle *findToggle(const char *_command)
+{
+    for (size_t i = 0; i < TOGGLES; i++)
+        if (!strcmp(_command, toggles[i].name))
+            return &toggles[i];
+
+    return NULL;
+}
+
+static bool parseState(const char *_command, Request &_request)
+{
+    static const char *const _modes[] = { "auto", "cool", "dry", "heat", "fan" };
+    static const char *const _speeds[] = { "none", "auto", "low", "med", "high" };
+    const char *_value = strchr(_command, '=');
+    int _index;
+
+    if (!strcmp(_command, "on"))
+        _request.active = true;
+    else if (!strcmp(_command, "off"))
+        _request.active = false;
+    else if (_value && !strncmp(_command, "temp=", 5))
+        _request.temperature = atoi(_value + 1);
+    else if (_value && !strncmp(_command, "mode=", 5) && (_index = lookup(_value + 1, _modes, 5)) >= 0)
+        _request.mode = (Mode)_index;
+    else if (_value && !strncmp(_command, "fan=", 4) && (_index = lookup(_value + 1, _speeds, 5)) > 0)
+        _request.fanSpeed = (FanSpeed)_index;
+    else
+        return false;
+
+    _request.state = true;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    Request _request = { false, true, DEFAULT_TEMP, DEFAULT_MODE, DEFAULT_FANSPEED };
+    const Toggle *_toggle;
+    uint8_t _frames;
+    int _fd;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "usage: %s device command...\n", argv[0]);
+        return 2;
+    }
+    for (int i = 2; i < argc; i++)
+    {
+        if (!parseState(argv[i], _request) && !findToggle(argv[i]))
+        {
+            fprintf(stderr, "unknown command: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if ((_fd = strcmp(argv[1], "-") ? ToyotomiLirc::open(argv[1]) : STDOUT_FILENO) < 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    ToyotomiLirc _unit(_fd, _request.temperature, _request.mode, _request.fanSpeed,
+                       DEFAULT_TIMER, DEFAULT_TIMER, _request.active);
+
+    _unit.begin();
+    if (_request.state)
+        _unit.forceResend();
+    for (int i = 2; i < argc; i++)
+        if ((_toggle = findToggle(argv[i])))
+            (_unit.*_toggle->button)();
+    if (!(_frames = _unit.send()))
+    {
+        fprintf(stderr, "%s: %s\n", argv[1], _unit.getError() ? strerror(_unit.getError()) : "nothing to send");
+        return 1;
+    }
+
+    fprintf(stderr, "%u frames in %u writes\n", _frames, (unsigned)_unit.getWrites());
+    return 0;
+}
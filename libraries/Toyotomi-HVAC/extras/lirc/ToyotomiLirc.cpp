@@ -0,0 +1,121 @@
+/*
+ * ToyotomiLirc.cpp - Toyotomi unit driven through a Linux LIRC device
+ *
+ * Release into the public domain.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/lirc.h>
+
+#include "ToyotomiLirc.h"
+
+ToyotomiLirc::ToyotomiLirc(int _fd, uint8_t _temperature, Mode _mode, FanSpeed _fanSpeed,
+                           TimerTime _timerOn, TimerTime _timerOff, bool _active)
+    : Toyotomi(_temperature, _mode, _fanSpeed, _timerOn, _timerOff, _active)
+{
+    uint32_t _carrier = Protocol::carrierHz;
+    
+    this->_fd = _fd;
+    this->_holding = false;
+    this->_queued = 0;
+    this->_count = 0;
+    this->_writes = 0;
+    this->_error = 0;
+    
+    // fails with ENOTTY on a pipe or file, which have no carrier to set
+    ioctl(this->_fd, LIRC_SET_SEND_CARRIER, &_carrier);
+}
+
+// creates _path if it is missing, a file standing in for the device
+int ToyotomiLirc::open(const char *_path)
+{
+    return ::open(_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+}
+
+void ToyotomiLirc::begin(void)
+{
+    this->_holding = true;
+    this->_queued = 0;
+    this->_error = 0;
+}
+
+// frames written, 0 if a write failed
+uint8_t ToyotomiLirc::send(void)
+{
+    this->_holding = false;
+    if (!this->_flush() || this->_error)
+        return 0;
+    
+    return this->_queued;
+}
+
+uint32_t ToyotomiLirc::getWrites(void)
+{
+    return this->_writes;
+}
+
+int ToyotomiLirc::getError(void)
+{
+    return this->_error;
+}
+
+
+void ToyotomiLirc::_transmit(const uint8_t _data[], const uint8_t _passes)
+{
+    if (this->_count + _passes * 2 * Protocol::symbols > LIRC_MAX_VALUES)
+        this->_flush();
+    
+    for (uint8_t _pass = 0; _pass < _passes; _pass++)
+    {
+        for (uint8_t _symbol = 0; _symbol < Protocol::symbols; _symbol++)
+        {
+            this->_values[this->_count++] = Protocol::mark(_symbol) * Protocol::unitUs;
+            this->_values[this->_count++] = Protocol::space(_data, _symbol) * Protocol::unitUs;
+        }
+    }
+    this->_queued++;
+    
+    if (!this->_holding)
+        this->_flush();
+}
+
+/*
+ * A transmit write has to start and end with a pulse, so the last space is
+ * left out and waited for here instead: the kernel returns once the pulses
+ * are out, and the unit needs the gap before the next frame.
+ */
+bool ToyotomiLirc::_flush(void)
+{
+    const uint8_t *_out = (const uint8_t *)this->_values;
+    size_t _left;
+    uint32_t _gap;
+    ssize_t _written;
+    
+    if (!this->_count)
+        return true;
+    
+    _left = (this->_count - 1) * sizeof(uint32_t);
+    _gap = this->_values[this->_count - 1];
+    this->_count = 0;
+    
+    while (_left)
+    {
+        _written = write(this->_fd, _out, _left);
+        if (_written < 0 && errno == EINTR)
+            continue;
+        if (_written < 0)
+        {
+            this->_error = errno;
+            return false;
+        }
+        _out += _written;       // only a pipe or file takes part of it
+        _left -= _written;
+    }
+    this->_writes++;
+    halDelayUs(_gap);
+    
+    return true;
+}
@@ -0,0 +1,60 @@
+/*
+ * ToyotomiLirc.h - Toyotomi unit driven through a Linux LIRC device
+ *
+ * For a gateway with an IR blaster in place of the Arduino. The state logic
+ * is the library's own; only the transmission differs: every frame becomes
+ * the pulse/space durations in microseconds that the kernel LIRC transmit
+ * interface (/dev/lircN, LIRC_MODE_PULSE) expects, and the whole array is
+ * handed over with one write(). Anything else that takes write() - a pipe,
+ * a file - stands in for the device.
+ *
+ *     int fd = ToyotomiLirc::open("/dev/lirc0");
+ *     ToyotomiLirc bedroom(fd);
+ *
+ *     bedroom.begin();
+ *     bedroom.setTemperature(22);
+ *     bedroom.buttonSwing();
+ *     bedroom.send();
+ *
+ * Between begin() and send() frames are queued in the buffer and send()
+ * writes them together, each ending with its trailer space as the gap to
+ * the next one. A frame that no longer fits flushes the queue first.
+ *
+ * Release into the public domain.
+*/
+
+#ifndef TOYOTOMI_LIRC_H
+#define TOYOTOMI_LIRC_H
+
+#include "Toyotomi.h"
+
+#define LIRC_MAX_VALUES  1024   // kernel limit of one transmit write, LIRCBUF_SIZE
+
+class ToyotomiLirc : public Toyotomi
+{
+    public:
+        ToyotomiLirc(int _fd, uint8_t _temp = DEFAULT_TEMP, Mode _mode = AUTO,
+                     FanSpeed _fanSpeed = DEFAULT_SP, TimerTime _timerOn = DEFAULT_TIMER,
+                     TimerTime _timerOff = DEFAULT_TIMER, bool = DEFAULT_POWER);
+        static int open(const char *_path);
+        void begin(void);
+        uint8_t send(void);
+        uint32_t getWrites(void);
+        int getError(void);
+    
+    protected:
+        virtual void _transmit(const uint8_t [], const uint8_t);
+    
+    private:
+        bool _flush(void);
+        
+        int _fd;
+        bool _holding;
+        uint8_t _queued;                    // frames since begin()
+        uint16_t _count;
+        uint32_t _writes;
+        int _error;                         // errno of the last failed write, 0 if none
+        uint32_t _values[LIRC_MAX_VALUES];  // pulse, space, ... in microseconds
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * RawConvert.cpp - Converts ToyotomiRaw.h records to Pronto hex and LIRC
+ *
+ * Usage: raw-convert [-p | -l] [capture]
+ *
+ * Reads the raw timing records a node streams with SERIAL_DEBUG (from the
+ * capture file, or standard input), skipping anything between them, and
+ * prints every frame as Pronto hex (-p), as a lircd.conf remote with one
+ * raw code per frame (-l), or both.
+ *
+ * Release into the public domain.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "ToyotomiRaw.h"
+
+// Pronto learned code: 0000, frequency, once pairs, repeat pairs, then pairs in carrier periods
+static void printPronto(const IRRawRecord &_record, const unsigned _index)
+{
+    double _periodsPerUnit = _record.unitUs * _record.carrierHz / 1e6;
+    std::vector<unsigned> _words;
+
+    IRRaw::expand(_record, [&](uint8_t _mark, uint8_t _space) {
+        _words.push_back(lround(_mark * _periodsPerUnit));
+        _words.push_back(lround(_space * _periodsPerUnit));
+    });
+
+    printf("frame%u: 0000 %04lX %04X 0000", _index, lround(1e6 / (_record.carrierHz * 0.241246)),
+           (unsigned)_words.size() / 2);
+    for (size_t i = 0; i < _words.size(); i++)
+        printf(" %04X", _words[i]);
+    printf("\n");
+}
+
+// LIRC raw codes start and end with a pulse, the last space becomes the gap
+static void printLirc(const std::vector<IRRawRecord> &_records)
+{
+    unsigned _gap = 0;
+
+    for (size_t r = 0; r < _records.size(); r++)
+        IRRaw::expand(_records[r], [&](uint8_t, uint8_t _space) {
+            _gap = _space * _records[r].unitUs;
+        });
+
+    printf("begin remote\n");
+    printf("  name       toyotomi\n");
+    printf("  flags      RAW_CODES\n");
+    printf("  eps        30\n");
+    printf("  aeps       100\n");
+    printf("  frequency  %u\n", _records.empty() ? 38000 : _records[0].carrierHz);
+    printf("  gap        %u\n", _gap);
+    printf("  begin raw_codes\n");
+    for (size_t r = 0; r < _records.size(); r++)
+    {
+        std::vector<unsigned> _us;
+
+        IRRaw::expand(_records[r], [&](uint8_t _mark, uint8_t _space) {
+            _us.push_back(_mark * _records[r].unitUs);
+            _us.push_back(_space * _records[r].unitUs);
+        });
+        if (!_us.empty())
+            _us.pop_back();
+
+        printf("    name frame%u\n", (unsigned)r);
+        for (size_t i = 0; i < _us.size(); i++)
+            printf("%s%u%s", i % 8 ? " " : "      ", _us[i], i % 8 == 7 || i + 1 == _us.size() ? "\n" : "");
+    }
+    printf("  end raw_codes\n");
+    printf("end remote\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bool _pronto = true, _lirc = true;
+    std::vector<uint8_t> _in;
+    std::vector<IRRawRecord> _records;
+    FILE *_file = stdin;
+    uint8_t _buf[4096];
+    size_t _read;
+    int i = 1;
+
+    if (i < argc && !strcmp(argv[i], "-p"))
+        _lirc = false, i++;
+    else if (i < argc && !strcmp(argv[i], "-l"))
+        _pronto = false, i++;
+    if (i < argc && !(_file = fopen(argv[i], "rb")))
+    {
+        perror(argv[i]);
+        return 1;
+    }
+
+    while ((_read = fread(_buf, 1, sizeof(_buf), _file)) > 0)
+        _in.insert(_in.end(), _buf, _buf + _read);
+
+    for (size_t _at = 0; _at < _in.size(); )
+    {
+        IRRawRecord _record;
+        uint16_t _len = IRRaw::parse(&_in[_at], _in.size() - _at > 0xFFFF ? 0xFFFF : _in.size() - _at,
+                                     _record);
+
+        if (!_len)
+        {
+            _at++;      // not a record here, resynchronise on the next magic byte
+            continue;
+        }
+        _records.push_back(_record);
+        _at += _len;
+    }
+
+    if (_records.empty())
+    {
+        fprintf(stderr, "no raw timing records found\n");
+        return 1;
+    }
+    for (size_t r = 0; _pronto && r < _records.size(); r++)
+        printPronto(_records[r], r);
+    if (_lirc)
+        printLirc(_records);
+
+    return 0;
+}